@@ -10,6 +10,8 @@ uint32_t bsp_time_get_ms();
 
 uint64_t bsp_time_get_us();
 
+uint64_t bsp_time_get_ns();
+
 uint64_t bsp_time_get();
 
 void bsp_time_init();
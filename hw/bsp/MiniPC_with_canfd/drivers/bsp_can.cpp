@@ -2,10 +2,13 @@
 
 #include <poll.h>
 #include <pthread.h>
+#include <string.h>
 
 #include <array>
+#include <atomic>
 
 #include "bsp_def.h"
+#include "bsp_time.h"
 #include "bsp_uart.h"
 
 #define CRC8_INIT 0Xff
@@ -14,6 +17,7 @@ typedef struct __attribute__((packed)) {
   uint8_t prefix;
   uint8_t id;
   uint32_t index;
+  uint32_t time; /* 下位机接收时间的低32位 单位：us */
   uint8_t data_len : 6;
   uint8_t ext : 1;
   uint8_t fd : 1;
@@ -27,7 +31,18 @@ typedef struct {
   void *arg;
 } can_callback_t;
 
-static const std::array<uint8_t, 256> CRC8_TAB = {
+/* 每个串口的接收缓冲区，单次read尽量读出驱动中积压的全部数据 */
+#define BSP_CAN_UART_RX_BUFF_SIZE (64 * 1024)
+
+typedef struct {
+  std::atomic<uint64_t> rx_byte;
+  std::atomic<uint32_t> rx_frame;
+  std::atomic<uint32_t> crc_error;
+  std::atomic<uint32_t> resync;
+  std::atomic<uint32_t> drop_byte;
+} uart_stat_t;
+
+static constexpr std::array<uint8_t, 256> CRC8_TAB = {
     0x00, 0x5e, 0xbc, 0xe2, 0x61, 0x3f, 0xdd, 0x83, 0xc2, 0x9c, 0x7e, 0x20,
     0xa3, 0xfd, 0x1f, 0x41, 0x9d, 0xc3, 0x21, 0x7f, 0xfc, 0xa2, 0x40, 0x1e,
     0x5f, 0x01, 0xe3, 0xbd, 0x3e, 0x60, 0x82, 0xdc, 0x23, 0x7d, 0x9f, 0xc1,
@@ -51,31 +66,61 @@ static const std::array<uint8_t, 256> CRC8_TAB = {
     0x74, 0x2a, 0xc8, 0x96, 0x15, 0x4b, 0xa9, 0xf7, 0xb6, 0xe8, 0x0a, 0x54,
     0xd7, 0x89, 0x6b, 0x35};
 
-uint8_t calculate(const uint8_t *buf, size_t len, uint8_t crc) {
-  /* loop over the buffer data */
-  while (len-- > 0) {
-    crc = CRC8_TAB[(crc ^ *buf++) & 0xff];
+/* 切片查表：CRC8_SLICE[k][x]为x再经过k个0字节后的CRC，
+ * 一次处理8字节，各字节的查表互不依赖 */
+static constexpr std::array<std::array<uint8_t, 256>, 8> crc8_slice_init() {
+  std::array<std::array<uint8_t, 256>, 8> tab = {};
+  tab[0] = CRC8_TAB;
+  for (size_t k = 1; k < tab.size(); k++) {
+    for (size_t x = 0; x < 256; x++) {
+      tab[k][x] = CRC8_TAB[tab[k - 1][x]];
+    }
   }
-  return crc;
+  return tab;
 }
 
-bool verify(const uint8_t *buf, size_t len) {
-  if (len < 2) {
-    return false;
+static constexpr std::array<std::array<uint8_t, 256>, 8> CRC8_SLICE =
+    crc8_slice_init();
+
+uint8_t calculate(const uint8_t *buf, size_t len, uint8_t crc) {
+  while (len >= 8) {
+    crc = CRC8_SLICE[7][crc ^ buf[0]] ^ CRC8_SLICE[6][buf[1]] ^
+          CRC8_SLICE[5][buf[2]] ^ CRC8_SLICE[4][buf[3]] ^
+          CRC8_SLICE[3][buf[4]] ^ CRC8_SLICE[2][buf[5]] ^
+          CRC8_SLICE[1][buf[6]] ^ CRC8_SLICE[0][buf[7]];
+    buf += 8;
+    len -= 8;
   }
 
-  uint8_t expected = calculate(buf, len - sizeof(uint8_t), CRC8_INIT);
-  return expected == buf[len - sizeof(uint8_t)];
+  while (len-- > 0) {
+    crc = CRC8_TAB[crc ^ *buf++];
+  }
+  return crc;
 }
 
 static can_callback_t callback_list[BSP_CAN_NUM][BSP_CAN_CB_NUM];
 
-static uint8_t uart_rx_buff[64][BSP_CAN_UART_NUM];
+static uint8_t uart_rx_buff[BSP_CAN_UART_NUM][BSP_CAN_UART_RX_BUFF_SIZE];
+
+static uart_stat_t uart_stat[BSP_CAN_UART_NUM];
 
-static uint8_t uart_tx_buff[128][BSP_CAN_UART_NUM];
+static pthread_mutex_t tx_queue_mutex[BSP_CAN_NUM];
 
-static pthread_mutex_t tx_mutex[BSP_CAN_UART_NUM] = {PTHREAD_MUTEX_INITIALIZER,
-                                                     PTHREAD_MUTEX_INITIALIZER};
+static uint64_t rx_time[BSP_CAN_NUM];
+
+/* 下位机时钟相对本机的偏差估计 */
+#define BSP_CAN_CLOCK_WINDOW_US (1000000)
+#define BSP_CAN_CLOCK_RESYNC_US (100000)
+
+typedef struct {
+  bool valid;
+  uint64_t remote; /* 展开为64位的下位机时间 */
+  int64_t offset;  /* 本机时间 - 下位机时间 */
+  int64_t window_min;
+  uint64_t window_start;
+} uart_clock_t;
+
+static uart_clock_t uart_clock[BSP_CAN_UART_NUM];
 
 inline bsp_can_t bsp_can_get(bsp_uart_t uart, uint8_t id) {
   return static_cast<bsp_can_t>(uart * 2 + id);
@@ -91,69 +136,180 @@ inline bsp_uart_t bsp_can_get_uart(bsp_can_t can) {
 
 inline uint8_t bsp_can_get_id(bsp_can_t can) { return can % 2; }
 
-void bsp_can_init(void) {
-  auto uart_rx_thread_fn = [](void *arg) {
-    bsp_uart_t uart = *static_cast<bsp_uart_t *>(arg);
+static void bsp_can_dispatch(bsp_can_t can, const UartDataHeader *header,
+                             uint8_t *data) {
+  if (header->fd) {
+    auto &cb = callback_list[can][CANFD_RX_MSG_CALLBACK];
+    if (cb.fn) {
+      bsp_canfd_data_t fd_data = {.size = header->data_len, .data = data};
+      cb.fn(can, header->index, reinterpret_cast<uint8_t *>(&fd_data), cb.arg);
+    }
+  } else {
+    auto &cb = callback_list[can][CAN_RX_MSG_CALLBACK];
+    if (cb.fn) {
+      cb.fn(can, header->index, data, cb.arg);
+    }
+  }
+}
 
-    while (true) {
-      auto index = uart_rx_buff[uart];
-      do {
-        bsp_uart_receive(uart, uart_rx_buff[uart], sizeof(uint8_t), true);
-      } while (*uart_rx_buff[uart] != 0xa5);
+/* 把帧中的下位机时间换算到本机时基。串口传输延迟只会使到达时间偏晚，
+ * 取一个窗口内(到达时间 - 帧时间)的最小值作为时钟偏差，
+ * 换算后的时间保留了帧在CAN总线上的原始间隔，不受串口排队抖动影响 */
+static uint64_t bsp_can_clock_convert(bsp_uart_t uart, uint32_t time,
+                                      uint64_t now) {
+  auto &clock = uart_clock[uart];
+
+  /* 两路CAN交替打包，时间戳可能略有回退，按有符号差值展开 */
+  if (clock.valid) {
+    clock.remote +=
+        static_cast<int32_t>(time - static_cast<uint32_t>(clock.remote));
+  } else {
+    clock.remote = time;
+  }
 
-      index++;
+  int64_t delay =
+      static_cast<int64_t>(now) - static_cast<int64_t>(clock.remote);
+
+  if (!clock.valid || delay < clock.offset ||
+      delay - clock.offset > BSP_CAN_CLOCK_RESYNC_US) {
+    /* 首帧、延迟更小或下位机复位，立即重新同步 */
+    clock.valid = true;
+    clock.offset = delay;
+    clock.window_min = delay;
+    clock.window_start = now;
+  } else if (now - clock.window_start >= BSP_CAN_CLOCK_WINDOW_US) {
+    /* 两边晶振的频差使偏差缓慢变化，每个窗口用窗口内的最小值重新估计 */
+    clock.offset = delay < clock.window_min ? delay : clock.window_min;
+    clock.window_min = delay;
+    clock.window_start = now;
+  } else if (delay < clock.window_min) {
+    clock.window_min = delay;
+  }
 
-      bsp_uart_receive(uart, index, sizeof(UartDataHeader) - 1, true);
-      index += sizeof(UartDataHeader) - 1;
+  return clock.remote + clock.offset;
+}
 
-      if (!verify(uart_rx_buff[uart], sizeof(UartDataHeader))) {
-        continue;
-      }
+/* 解析缓冲区中所有完整的帧，返回已处理的字节数，剩余不足一帧的数据留到下次 */
+static size_t bsp_can_parse(bsp_uart_t uart, uint8_t *buff, size_t len,
+                            uint64_t time) {
+  auto &stat = uart_stat[uart];
+  size_t pos = 0;
+
+  while (len - pos >= sizeof(UartDataHeader)) {
+    if (buff[pos] != 0xa5) {
+      /* 帧同步丢失，直接跳到下一个帧头 */
+      auto next = static_cast<uint8_t *>(memchr(buff + pos, 0xa5, len - pos));
+      size_t skip = next ? static_cast<size_t>(next - (buff + pos)) : len - pos;
+      stat.resync.fetch_add(1, std::memory_order_relaxed);
+      stat.drop_byte.fetch_add(skip, std::memory_order_relaxed);
+      pos += skip;
+      continue;
+    }
+
+    auto header = reinterpret_cast<UartDataHeader *>(buff + pos);
+    size_t frame_len = sizeof(UartDataHeader) + header->data_len + 1;
+
+    if (calculate(buff + pos, sizeof(UartDataHeader) - 1, CRC8_INIT) !=
+            header->crc8 ||
+        header->id >= 2) {
+      stat.crc_error.fetch_add(1, std::memory_order_relaxed);
+      stat.drop_byte.fetch_add(1, std::memory_order_relaxed);
+      pos++;
+      continue;
+    }
+
+    if (len - pos < frame_len) {
+      break;
+    }
+
+    /* 帧头CRC正确时，计算到帧头末尾的CRC恰好为0，只需从数据段继续计算 */
+    uint8_t *data = buff + pos + sizeof(UartDataHeader);
+    if (calculate(data, header->data_len, 0) != data[header->data_len]) {
+      stat.crc_error.fetch_add(1, std::memory_order_relaxed);
+      stat.drop_byte.fetch_add(1, std::memory_order_relaxed);
+      pos++;
+      continue;
+    }
+
+    bsp_can_t can = bsp_can_get(uart, header->id);
+    rx_time[can] = bsp_can_clock_convert(uart, header->time, time);
+    bsp_can_dispatch(can, header, data);
+
+    stat.rx_frame.fetch_add(1, std::memory_order_relaxed);
+    pos += frame_len;
+  }
 
-      auto header = reinterpret_cast<UartDataHeader *>(uart_rx_buff[uart]);
+  return pos;
+}
+
+void bsp_can_init(void) {
+  for (int i = 0; i < BSP_CAN_NUM; i++) {
+    pthread_mutex_init(&tx_queue_mutex[i], NULL);
+  }
 
-      bsp_uart_receive(uart, index, header->data_len + 1, true);
+  auto uart_rx_thread_fn = [](void *arg) {
+    bsp_uart_t uart = *static_cast<bsp_uart_t *>(arg);
+    uint8_t *buff = uart_rx_buff[uart];
+    size_t len = 0;
 
-      if (!verify(uart_rx_buff[uart],
-                  sizeof(UartDataHeader) + header->data_len + 1)) {
+    while (true) {
+      /* 一次读出所有已到达的数据，批量解析和分发 */
+      if (bsp_uart_receive_some(uart, buff + len,
+                                BSP_CAN_UART_RX_BUFF_SIZE - len,
+                                1000) != BSP_OK) {
         continue;
       }
 
-      if (header->fd) {
-        if (callback_list[bsp_can_get(uart, header->id)][CANFD_RX_MSG_CALLBACK]
-                .fn) {
-          bsp_canfd_data_t data = {.size = header->data_len, .data = index};
-          callback_list[bsp_can_get(uart, header->id)][CANFD_RX_MSG_CALLBACK]
-              .fn(bsp_can_get(uart, header->id), header->index,
-                  reinterpret_cast<uint8_t *>(&data),
-                  callback_list[bsp_can_get(uart, header->id)]
-                               [CANFD_RX_MSG_CALLBACK]
-                                   .arg);
-        } else {
-          if (callback_list[bsp_can_get(uart, header->id)][CAN_RX_MSG_CALLBACK]
-                  .fn) {
-            callback_list[bsp_can_get(uart, header->id)][CAN_RX_MSG_CALLBACK]
-                .fn(bsp_can_get(uart, header->id), header->index, index,
-                    callback_list[bsp_can_get(uart, header->id)]
-                                 [CAN_RX_MSG_CALLBACK]
-                                     .arg);
-          }
-        }
+      size_t count = bsp_uart_get_count(uart);
+      uart_stat[uart].rx_byte.fetch_add(count, std::memory_order_relaxed);
+      len += count;
+
+      size_t used = bsp_can_parse(uart, buff, len, bsp_time_get_us());
+
+      /* 剩余数据不足一帧，移到缓冲区开头 */
+      len -= used;
+      if (len > 0 && used > 0) {
+        memmove(buff, buff + used, len);
       }
     }
 
     return static_cast<void *>(0);
   };
 
+  /* 串口发送缓冲区清空后，通知Device::Can继续发出同一串口上两路CAN的发送队列 */
+  auto uart_tx_cplt_fn = [](void *arg) {
+    bsp_uart_t uart = *static_cast<bsp_uart_t *>(arg);
+
+    for (uint8_t id = 0; id < 2; id++) {
+      bsp_can_t can = bsp_can_get(uart, id);
+      can_callback_t &cb = callback_list[can][CAN_TX_CPLT_CALLBACK];
+      if (cb.fn) {
+        pthread_mutex_lock(&tx_queue_mutex[can]);
+        cb.fn(can, 0, NULL, cb.arg);
+        pthread_mutex_unlock(&tx_queue_mutex[can]);
+      }
+    }
+  };
+
   static bsp_uart_t uart[BSP_CAN_UART_NUM];
   static pthread_t thread[BSP_CAN_UART_NUM];
 
   for (int i = 0; i < BSP_CAN_UART_NUM; i++) {
     uart[i] = static_cast<bsp_uart_t>(i);
+    bsp_uart_register_callback(uart[i], BSP_UART_TX_CPLT_CB, uart_tx_cplt_fn,
+                               &uart[i]);
     pthread_create(&thread[i], NULL, uart_rx_thread_fn, &uart[i]);
   }
 }
 
+/* 数据经串口转发，无硬件过滤，由Device::Can在软件中分发 */
+bsp_status_t bsp_can_add_filter(bsp_can_t can, uint32_t id, uint32_t mask) {
+  (void)can;
+  (void)id;
+  (void)mask;
+  return BSP_OK;
+}
+
 bsp_status_t bsp_can_register_callback(
     bsp_can_t can, bsp_can_callback_t type,
     void (*callback)(bsp_can_t can, uint32_t id, uint8_t *data, void *arg),
@@ -166,26 +322,46 @@ bsp_status_t bsp_can_register_callback(
   return BSP_OK;
 };
 
-bsp_status_t bsp_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
-                                  uint32_t id, uint8_t *data) {
-  auto uart = bsp_can_get_uart(can);
+/* 组帧后复制到串口发送缓冲区即返回，由串口IO线程合并发出 */
+static bsp_status_t bsp_can_uart_trans(bsp_can_t can, bsp_can_format_t format,
+                                       uint32_t id, uint8_t *data, size_t size,
+                                       bool fd, bool block) {
+  /* 帧头中的长度字段只有6位，64字节的CAN FD帧无法编码，与MCU端一致丢弃 */
+  if (size > 63) {
+    return BSP_ERR;
+  }
+
+  uint8_t buff[sizeof(UartDataHeader) + 63 + 1];
 
-  pthread_mutex_lock(&tx_mutex[uart]);
-  auto header = reinterpret_cast<UartDataHeader *>(uart_tx_buff[uart]);
+  auto header = reinterpret_cast<UartDataHeader *>(buff);
   header->prefix = 0xa5;
   header->id = bsp_can_get_id(can);
-  header->data_len = 8;
-  header->fd = false;
+  header->data_len = size;
+  header->fd = fd;
   header->ext = (format == CAN_FORMAT_EXT) ? 1 : 0;
   header->index = id;
-  header->crc8 = calculate(reinterpret_cast<uint8_t *>(header),
-                           sizeof(UartDataHeader) - 1, CRC8_INIT);
-  memcpy(uart_tx_buff[uart] + sizeof(UartDataHeader), data, 8);
-  *(uart_tx_buff[uart] + sizeof(UartDataHeader) + 8) =
-      calculate(uart_tx_buff[uart], sizeof(UartDataHeader) + 8, CRC8_INIT);
-  bsp_uart_transmit(uart, uart_tx_buff[uart], sizeof(UartDataHeader) + 9, true);
-  pthread_mutex_unlock(&tx_mutex[uart]);
-  return BSP_OK;
+  header->time = 0;
+  header->crc8 = calculate(buff, sizeof(UartDataHeader) - 1, CRC8_INIT);
+  memcpy(buff + sizeof(UartDataHeader), data, size);
+  buff[sizeof(UartDataHeader) + size] =
+      calculate(buff, sizeof(UartDataHeader) + size, CRC8_INIT);
+
+  auto uart = bsp_can_get_uart(can);
+  size_t len = sizeof(UartDataHeader) + size + 1;
+
+  bsp_status_t ans = bsp_uart_transmit(uart, buff, len, false);
+
+  /* 缓冲区已满时阻塞版本等待数据发出 */
+  if (ans == BSP_ERR_FULL && block) {
+    ans = bsp_uart_transmit(uart, buff, len, true);
+  }
+
+  return ans;
+}
+
+bsp_status_t bsp_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
+                                  uint32_t id, uint8_t *data) {
+  return bsp_can_uart_trans(can, format, id, data, 8, false, true);
 }
 
 bsp_status_t bsp_canfd_trans_packet(bsp_can_t can, bsp_can_format_t format,
@@ -194,27 +370,41 @@ bsp_status_t bsp_canfd_trans_packet(bsp_can_t can, bsp_can_format_t format,
     XB_ASSERT(false);
   }
 
-  if (size > 64) {
-    XB_ASSERT(false);
-  }
+  return bsp_can_uart_trans(can, format, id, data, size, true, true);
+}
 
-  auto uart = bsp_can_get_uart(can);
+bsp_status_t bsp_can_trans_packet_nowait(bsp_can_t can,
+                                         bsp_can_format_t format, uint32_t id,
+                                         uint8_t *data) {
+  return bsp_can_uart_trans(can, format, id, data, 8, false, false);
+}
 
-  pthread_mutex_lock(&tx_mutex[uart]);
-  auto header = reinterpret_cast<UartDataHeader *>(uart_tx_buff[uart]);
-  header->prefix = 0xa5;
-  header->id = bsp_can_get_id(can);
-  header->data_len = size;
-  header->fd = true;
-  header->ext = (format == CAN_FORMAT_EXT) ? 1 : 0;
-  header->index = id;
-  header->crc8 = calculate(reinterpret_cast<uint8_t *>(header),
-                           sizeof(UartDataHeader) - 1, CRC8_INIT);
-  memcpy(uart_tx_buff[uart] + sizeof(UartDataHeader), data, size);
-  *(uart_tx_buff[uart] + sizeof(UartDataHeader) + size) =
-      calculate(uart_tx_buff[uart], sizeof(UartDataHeader) + size, CRC8_INIT);
-  bsp_uart_transmit(uart, uart_tx_buff[uart], sizeof(UartDataHeader) + size + 1,
-                    true);
-  pthread_mutex_unlock(&tx_mutex[uart]);
+bsp_status_t bsp_canfd_trans_packet_nowait(bsp_can_t can,
+                                           bsp_can_format_t format,
+                                           uint32_t id, uint8_t *data,
+                                           size_t size) {
+  return bsp_can_uart_trans(can, format, id, data, size, true, false);
+}
+
+void bsp_can_tx_lock(bsp_can_t can) {
+  pthread_mutex_lock(&tx_queue_mutex[can]);
+}
+
+void bsp_can_tx_unlock(bsp_can_t can) {
+  pthread_mutex_unlock(&tx_queue_mutex[can]);
+}
+
+uint64_t bsp_can_get_rx_time(bsp_can_t can) { return rx_time[can]; }
+
+bsp_status_t bsp_can_get_bridge_stat(bsp_can_t can,
+                                     bsp_can_bridge_stat_t *stat) {
+  XB_ASSERT(stat);
+
+  auto &uart = uart_stat[bsp_can_get_uart(can)];
+  stat->rx_byte = uart.rx_byte.load(std::memory_order_relaxed);
+  stat->rx_frame = uart.rx_frame.load(std::memory_order_relaxed);
+  stat->crc_error = uart.crc_error.load(std::memory_order_relaxed);
+  stat->resync = uart.resync.load(std::memory_order_relaxed);
+  stat->drop_byte = uart.drop_byte.load(std::memory_order_relaxed);
   return BSP_OK;
 }
@@ -3,7 +3,14 @@
 #define termios asmtermios
 #include <asm/termbits.h>
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -21,6 +28,24 @@ static int rx_count[BSP_UART_NUM];
 
 static bool uart_block[BSP_UART_NUM];
 
+/* 发送环形缓冲区，head/tail为累计写入/发出的字节数，取模得到下标。
+ * 发送由IO线程完成，缓冲区中积压的多帧数据合并为一次write */
+typedef struct {
+  int fd; /* 独立打开的非阻塞写描述符，不受接收时切换阻塞模式影响 */
+  uint8_t *buff;
+  uint64_t head;
+  uint64_t tail;
+  bool wait_out; /* 内核缓冲区已满，等待EPOLLOUT */
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+} uart_tx_t;
+
+static uart_tx_t uart_tx[BSP_UART_NUM];
+
+static int tx_epoll_fd = -1;
+static int tx_event_fd = -1;
+static pthread_t tx_thread;
+
 static const char *uart_dev_path[] = {"/dev/ttyCH343USB1", "/dev/ttyCH343USB0"};
 
 static const uint32_t UART_SPEED[] = {9000000, 9000000};
@@ -170,6 +195,125 @@ static int libtty_setopt(int fd, int speed, int databits, int stopbits,
   return 0;
 }
 
+static void uart_tx_arm(int uart, bool out) {
+  struct epoll_event ev = {.events = out ? EPOLLOUT : 0, .data.u32 = uart};
+  epoll_ctl(tx_epoll_fd, EPOLL_CTL_MOD, uart_tx[uart].fd, &ev);
+}
+
+/* 尽量发出缓冲区中的全部数据，返回缓冲区是否由非空变为空 */
+static bool uart_tx_flush(int uart) {
+  uart_tx_t *tx = &uart_tx[uart];
+  bool sent = false;
+
+  pthread_mutex_lock(&tx->mutex);
+  while (tx->head != tx->tail) {
+    size_t offset = tx->tail % BSP_UART_TX_BUFF_SIZE;
+    size_t len = tx->head - tx->tail;
+    if (len > BSP_UART_TX_BUFF_SIZE - offset) {
+      len = BSP_UART_TX_BUFF_SIZE - offset;
+    }
+
+    /* 只有IO线程修改tail，写入期间其他线程可以继续追加数据 */
+    pthread_mutex_unlock(&tx->mutex);
+    ssize_t ans = write(tx->fd, tx->buff + offset, len);
+    pthread_mutex_lock(&tx->mutex);
+
+    if (ans > 0) {
+      tx->tail += ans;
+      sent = true;
+      pthread_cond_broadcast(&tx->cond);
+      continue;
+    }
+
+    if (ans < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (ans < 0 && errno != EAGAIN) {
+      /* 设备已断开，丢弃积压的数据避免阻塞发送方，之后的发送返回BSP_ERR_NO_DEV */
+      perror("uart write failed");
+      epoll_ctl(tx_epoll_fd, EPOLL_CTL_DEL, tx->fd, NULL);
+      close(tx->fd);
+      tx->fd = -1;
+      tx->wait_out = false;
+      tx->tail = tx->head;
+      pthread_cond_broadcast(&tx->cond);
+      break;
+    }
+
+    if (!tx->wait_out) {
+      tx->wait_out = true;
+      uart_tx_arm(uart, true);
+    }
+    break;
+  }
+
+  bool empty = tx->head == tx->tail;
+  if (empty && tx->wait_out) {
+    tx->wait_out = false;
+    uart_tx_arm(uart, false);
+  }
+  pthread_mutex_unlock(&tx->mutex);
+
+  return sent && empty;
+}
+
+static void *uart_tx_thread_fn(void *arg) {
+  (void)arg;
+  struct epoll_event events[BSP_UART_NUM + 1];
+
+  while (true) {
+    int num = epoll_wait(tx_epoll_fd, events, BSP_UART_NUM + 1, -1);
+    if (num < 0) {
+      continue;
+    }
+
+    for (int i = 0; i < num; i++) {
+      if (events[i].data.u32 == BSP_UART_NUM) {
+        uint64_t count = 0;
+        read(tx_event_fd, &count, sizeof(count));
+      }
+    }
+
+    for (int i = 0; i < BSP_UART_NUM; i++) {
+      if (uart_tx_flush(i) && callback_list[i][BSP_UART_TX_CPLT_CB].fn) {
+        callback_list[i][BSP_UART_TX_CPLT_CB].fn(
+            callback_list[i][BSP_UART_TX_CPLT_CB].arg);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+static void uart_tx_init() {
+  tx_epoll_fd = epoll_create1(0);
+  tx_event_fd = eventfd(0, EFD_NONBLOCK);
+  XB_ASSERT(tx_epoll_fd >= 0 && tx_event_fd >= 0);
+
+  struct epoll_event ev = {.events = EPOLLIN, .data.u32 = BSP_UART_NUM};
+  epoll_ctl(tx_epoll_fd, EPOLL_CTL_ADD, tx_event_fd, &ev);
+
+  for (int i = 0; i < BSP_UART_NUM; i++) {
+    uart_tx_t *tx = &uart_tx[i];
+    tx->fd = open(uart_dev_path[i], O_WRONLY | O_NOCTTY | O_NONBLOCK);
+    tx->buff = malloc(BSP_UART_TX_BUFF_SIZE);
+    XB_ASSERT(tx->buff);
+    pthread_mutex_init(&tx->mutex, NULL);
+    pthread_cond_init(&tx->cond, NULL);
+
+    if (tx->fd < 0) {
+      perror("open device failed");
+      continue;
+    }
+
+    struct epoll_event out = {.events = 0, .data.u32 = i};
+    epoll_ctl(tx_epoll_fd, EPOLL_CTL_ADD, tx->fd, &out);
+  }
+
+  pthread_create(&tx_thread, NULL, uart_tx_thread_fn, NULL);
+}
+
 void bsp_uart_init() {
   for (int i = 0; i < BSP_UART_NUM; i++) {
     uart_fd[i] = libtty_open(uart_dev_path[i]);
@@ -178,6 +322,8 @@ void bsp_uart_init() {
     }
     libtty_setopt(uart_fd[i], UART_SPEED[i], 8, 1, 'n', 0);
   }
+
+  uart_tx_init();
 }
 
 bsp_status_t bsp_uart_register_callback(bsp_uart_t uart,
@@ -194,13 +340,67 @@ bsp_status_t bsp_uart_register_callback(bsp_uart_t uart,
 
 bsp_status_t bsp_uart_transmit(bsp_uart_t uart, uint8_t *data, size_t size,
                                bool block) {
+  uart_tx_t *tx = &uart_tx[uart];
+
+  if (size == 0) {
+    return BSP_OK;
+  }
+
+  pthread_mutex_lock(&tx->mutex);
+
+  if (tx->fd < 0) {
+    pthread_mutex_unlock(&tx->mutex);
+    return BSP_ERR_NO_DEV;
+  }
+
+  if (!block && BSP_UART_TX_BUFF_SIZE - (tx->head - tx->tail) < size) {
+    pthread_mutex_unlock(&tx->mutex);
+    return BSP_ERR_FULL;
+  }
+
+  bool idle = tx->head == tx->tail;
+
+  /* 阻塞模式下等待足够的空间，保证一次发送的数据在缓冲区中连续，
+   * 只有超过缓冲区容量的数据才分段写入 */
+  while (size > 0) {
+    size_t space = BSP_UART_TX_BUFF_SIZE - (tx->head - tx->tail);
+    if (space < size && space < BSP_UART_TX_BUFF_SIZE) {
+      uint64_t one = 1;
+      write(tx_event_fd, &one, sizeof(one));
+      pthread_cond_wait(&tx->cond, &tx->mutex);
+      continue;
+    }
+
+    size_t len = size < space ? size : space;
+    size_t offset = tx->head % BSP_UART_TX_BUFF_SIZE;
+    size_t first = BSP_UART_TX_BUFF_SIZE - offset;
+    if (first > len) {
+      first = len;
+    }
+
+    memcpy(tx->buff + offset, data, first);
+    memcpy(tx->buff, data + first, len - first);
+    tx->head += len;
+    data += len;
+    size -= len;
+  }
+
+  uint64_t end = tx->head;
+
+  /* IO线程正在发送或等待EPOLLOUT时会自行取走新数据 */
+  if (idle) {
+    uint64_t one = 1;
+    write(tx_event_fd, &one, sizeof(one));
+  }
+
   if (block) {
-    write(uart_fd[uart], data, size);
-    return true;
-  } else {
-    assert(false);
-    return BSP_ERR;
+    while (tx->tail < end) {
+      pthread_cond_wait(&tx->cond, &tx->mutex);
+    }
   }
+
+  pthread_mutex_unlock(&tx->mutex);
+  return BSP_OK;
 }
 
 bsp_status_t bsp_uart_receive(bsp_uart_t uart, uint8_t *buff, size_t size,
@@ -227,6 +427,30 @@ rework:
   return true;
 }
 
+bsp_status_t bsp_uart_receive_some(bsp_uart_t uart, uint8_t *buff, size_t size,
+                                   uint32_t timeout) {
+  struct pollfd pfd = {.fd = uart_fd[uart], .events = POLLIN, .revents = 0};
+
+  rx_count[uart] = 0;
+
+  int ans = poll(&pfd, 1, (int)timeout);
+  if (ans == 0) {
+    return BSP_ERR_TIMEOUT;
+  }
+  if (ans < 0 || !(pfd.revents & POLLIN)) {
+    return BSP_ERR;
+  }
+
+  /* poll返回可读后read不会阻塞，阻塞与非阻塞模式下行为相同 */
+  int len = read(uart_fd[uart], buff, size);
+  if (len <= 0) {
+    return BSP_ERR;
+  }
+
+  rx_count[uart] = len;
+  return BSP_OK;
+}
+
 uint32_t bsp_uart_get_count(bsp_uart_t uart) { return rx_count[uart]; }
 
 bsp_status_t bsp_uart_abort_receive(bsp_uart_t uart) {
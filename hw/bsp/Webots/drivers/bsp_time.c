@@ -2,8 +2,13 @@
 
 #include <webots/robot.h>
 
-uint32_t bsp_time_get_ms() { return wb_robot_get_time() * 1000; }
-
-uint64_t bsp_time_get_us() { return wb_robot_get_time() * 1000000; }
+/* 仿真时间是基本步长的整数倍，四舍五入避免浮点误差导致少计1us */
+uint32_t bsp_time_get_ms() {
+  return (uint32_t)(wb_robot_get_time() * 1000.0 + 0.5);
+}
+
+uint64_t bsp_time_get_us() {
+  return (uint64_t)(wb_robot_get_time() * 1000000.0 + 0.5);
+}
 
 uint64_t bsp_time_get() __attribute__((alias("bsp_time_get_us")));
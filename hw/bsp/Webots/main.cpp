@@ -1,3 +1,4 @@
+#include <scheduler.hpp>
 #include <thread.hpp>
 
 #include "bsp.h"
@@ -6,8 +7,6 @@
 int main() {
   bsp_init();
   robot_init();
-  while (1) {
-    wb_robot_step(1);
-    poll(NULL, 0, 1);
-  }
+  /* 所有线程阻塞后才推进仿真时间 */
+  System::Scheduler::Run();
 }
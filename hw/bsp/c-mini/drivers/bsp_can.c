@@ -2,6 +2,8 @@
 
 #include "FreeRTOS.h"
 #include "bsp.h"
+#include "bsp_sys.h"
+#include "bsp_time.h"
 #include "bsp_uart.h"
 #include "main.h"
 #include "semphr.h"
@@ -41,12 +43,12 @@ static can_callback_t callback_list[BSP_CAN_NUM][BSP_CAN_CB_NUM];
 
 static bool bsp_can_initd = false;
 
-static uint32_t mailbox[BSP_CAN_BASE_NUM];
-
 static can_raw_rx_t rx_buff[BSP_CAN_BASE_NUM];
-static CAN_TxHeaderTypeDef tx_buff[BSP_CAN_BASE_NUM];
 static CanUartPack tx_ext_buff[BSP_CAN_EXT_NUM];
 
+/* 接收中断的进入时间，同一次中断中读出的帧共用 */
+static uint64_t rx_time[BSP_CAN_NUM];
+
 static SemaphoreHandle_t tx_cplt[BSP_CAN_EXT_NUM];
 
 static SemaphoreHandle_t rx_cplt_wait_sem[BSP_CAN_BASE_NUM];
@@ -83,7 +85,16 @@ static bsp_can_t can_get(CAN_HandleTypeDef *hcan) {
   }
 }
 
+static void can_tx_cplt_cb_fn(bsp_can_t can) {
+  if (callback_list[can][CAN_TX_CPLT_CALLBACK].fn) {
+    callback_list[can][CAN_TX_CPLT_CALLBACK].fn(
+        can, 0, NULL, callback_list[can][CAN_TX_CPLT_CALLBACK].arg);
+  }
+}
+
 void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) {
+  can_tx_cplt_cb_fn(can_get(hcan));
+
   BaseType_t px_higher_priority_task_woken = 0;
   xSemaphoreGiveFromISR(rx_cplt_wait_sem[can_get(hcan)],
                         &px_higher_priority_task_woken);
@@ -93,6 +104,8 @@ void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) {
 }
 
 void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan) {
+  can_tx_cplt_cb_fn(can_get(hcan));
+
   BaseType_t px_higher_priority_task_woken = 0;
   xSemaphoreGiveFromISR(rx_cplt_wait_sem[can_get(hcan)],
                         &px_higher_priority_task_woken);
@@ -102,6 +115,8 @@ void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan) {
 }
 
 void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan) {
+  can_tx_cplt_cb_fn(can_get(hcan));
+
   BaseType_t px_higher_priority_task_woken = 0;
   xSemaphoreGiveFromISR(rx_cplt_wait_sem[can_get(hcan)],
                         &px_higher_priority_task_woken);
@@ -124,12 +139,21 @@ static void tx_cplt_callback(void *arg) {
   SemaphoreHandle_t *sem = (SemaphoreHandle_t *)arg;
   BaseType_t px_higher_priority_task_woken = 0;
   xSemaphoreGiveFromISR(sem, &px_higher_priority_task_woken);
+
+  for (int i = 0; i < BSP_CAN_EXT_NUM; i++) {
+    if ((void *)tx_cplt[i] == arg) {
+      can_tx_cplt_cb_fn(i + BSP_CAN_BASE_NUM);
+    }
+  }
+
   portYIELD_FROM_ISR(px_higher_priority_task_woken);
 }
 
 static void rx_callback_fn(void *arg) {
   bsp_can_t can = (uint8_t **)(arg)-uart_recv_buff_addr + BSP_CAN_BASE_NUM;
 
+  rx_time[can] = bsp_time_get_us();
+
   int32_t index = 0;
   uint8_t *data = *(uint8_t **)(arg);
   uint32_t len = bsp_uart_get_count(bsp_ext_can_get_handle(can));
@@ -222,6 +246,8 @@ void bsp_can_init(void) {
 }
 
 static void can_rx_cb_fn(bsp_can_t can) {
+  rx_time[can] = bsp_time_get_us();
+
   uint32_t fifo = CAN_FILTER_FIFO0;
 
   if (can == BSP_CAN_2) {
@@ -255,6 +281,74 @@ void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan) {
   can_rx_cb_fn(BSP_CAN_2);
 }
 
+/* 每个CAN可用的过滤器组数量，第一组在启用过滤后只放行扩展帧 */
+#define BSP_CAN_FILTER_NUM (14)
+
+static uint8_t filter_num[BSP_CAN_BASE_NUM];
+static bool filter_all[BSP_CAN_BASE_NUM];
+static uint32_t filter_list[BSP_CAN_BASE_NUM][BSP_CAN_FILTER_NUM][2];
+
+static void can_config_filter(bsp_can_t can, uint32_t index, uint32_t id_high,
+                              uint32_t id_low, uint32_t mask_high,
+                              uint32_t mask_low) {
+  uint32_t bank = can == BSP_CAN_2 ? 14 : 0;
+  uint32_t fifo = can == BSP_CAN_2 ? CAN_FILTER_FIFO1 : CAN_FILTER_FIFO0;
+
+  CAN_FilterTypeDef can_filter = {0};
+
+  can_filter.FilterBank = bank + index;
+  can_filter.FilterIdHigh = id_high;
+  can_filter.FilterIdLow = id_low;
+  can_filter.FilterMode = CAN_FILTERMODE_IDMASK;
+  can_filter.FilterScale = CAN_FILTERSCALE_32BIT;
+  can_filter.FilterMaskIdHigh = mask_high;
+  can_filter.FilterMaskIdLow = mask_low;
+  can_filter.FilterActivation = ENABLE;
+  can_filter.SlaveStartFilterBank = 14;
+  can_filter.FilterFIFOAssignment = fifo;
+
+  HAL_CAN_ConfigFilter(bsp_can_get_handle(can), &can_filter);
+}
+
+bsp_status_t bsp_can_add_filter(bsp_can_t can, uint32_t id, uint32_t mask) {
+  if (can >= BSP_CAN_BASE_NUM) {
+    return BSP_OK;
+  }
+
+  if (filter_all[can]) {
+    return BSP_OK;
+  }
+
+  mask &= 0x7ff;
+  id &= mask;
+
+  for (int i = 1; i <= filter_num[can]; i++) {
+    if (filter_list[can][i][0] == id && filter_list[can][i][1] == mask) {
+      return BSP_OK;
+    }
+  }
+
+  /* 第0组用于只放行扩展帧，第1到BSP_CAN_FILTER_NUM - 1组用于标准帧ID */
+  if (mask == 0 || filter_num[can] >= BSP_CAN_FILTER_NUM - 1) {
+    /* 第一组恢复为接收所有帧，其余过滤器都是它的子集，无需关闭 */
+    filter_all[can] = true;
+    can_config_filter(can, 0, 0, 0, 0, 0);
+    return mask == 0 ? BSP_OK : BSP_ERR_FULL;
+  }
+
+  /* 32位掩码模式下STID位于高16位的[15:5]，IDE位于低16位的bit2 */
+  filter_num[can]++;
+  filter_list[can][filter_num[can]][0] = id;
+  filter_list[can][filter_num[can]][1] = mask;
+  can_config_filter(can, filter_num[can], id << 5, 0, mask << 5, CAN_ID_EXT);
+
+  if (filter_num[can] == 1) {
+    can_config_filter(can, 0, 0, CAN_ID_EXT, 0, CAN_ID_EXT);
+  }
+
+  return BSP_OK;
+}
+
 bsp_status_t bsp_can_register_callback(
     bsp_can_t can, bsp_can_callback_t type,
     void (*callback)(bsp_can_t can, uint32_t id, uint8_t *data, void *arg),
@@ -267,14 +361,13 @@ bsp_status_t bsp_can_register_callback(
   return BSP_OK;
 }
 
-bsp_status_t bsp_ext_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
-                                      uint32_t id, uint8_t *data) {
+static bsp_status_t ext_can_transmit(bsp_can_t can, bsp_can_format_t format,
+                                     uint32_t id, uint8_t *data) {
   tx_ext_buff[can - BSP_CAN_BASE_NUM].id = id;
   tx_ext_buff[can - BSP_CAN_BASE_NUM].type = format;
   memcpy(tx_ext_buff[can - BSP_CAN_BASE_NUM].data, data, 8);
   tx_ext_buff[can - BSP_CAN_BASE_NUM].start_frame = START;
   tx_ext_buff[can - BSP_CAN_BASE_NUM].end_frame = END;
-  xSemaphoreTake(tx_cplt[can - BSP_CAN_BASE_NUM], UINT32_MAX);
   return bsp_uart_transmit(bsp_ext_can_get_handle(can),
                            (uint8_t *)(&tx_ext_buff[can - BSP_CAN_BASE_NUM]),
                            sizeof(tx_ext_buff[can - BSP_CAN_BASE_NUM]),
@@ -283,24 +376,37 @@ bsp_status_t bsp_ext_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
              : BSP_ERR;
 }
 
+bsp_status_t bsp_ext_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
+                                      uint32_t id, uint8_t *data) {
+  xSemaphoreTake(tx_cplt[can - BSP_CAN_BASE_NUM], UINT32_MAX);
+  return ext_can_transmit(can, format, id, data);
+}
+
+static bsp_status_t bsp_ext_can_trans_packet_nowait(bsp_can_t can,
+                                                    bsp_can_format_t format,
+                                                    uint32_t id,
+                                                    uint8_t *data) {
+  BaseType_t ans = pdFALSE;
+
+  if (bsp_sys_in_isr()) {
+    ans = xSemaphoreTakeFromISR(tx_cplt[can - BSP_CAN_BASE_NUM], NULL);
+  } else {
+    ans = xSemaphoreTake(tx_cplt[can - BSP_CAN_BASE_NUM], 0);
+  }
+
+  if (ans != pdTRUE) {
+    return BSP_ERR_FULL;
+  }
+
+  return ext_can_transmit(can, format, id, data);
+}
+
 bsp_status_t bsp_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
                                   uint32_t id, uint8_t *data) {
   if (can >= BSP_CAN_BASE_NUM) {
     return bsp_ext_can_trans_packet(can, format, id, data);
   }
 
-  if (format == CAN_FORMAT_STD) {
-    tx_buff[can].StdId = id;
-    tx_buff[can].IDE = CAN_ID_STD;
-  } else {
-    tx_buff[can].ExtId = id;
-    tx_buff[can].IDE = CAN_ID_EXT;
-  }
-
-  tx_buff[can].RTR = CAN_RTR_DATA;
-  tx_buff[can].TransmitGlobalTime = DISABLE;
-  tx_buff[can].DLC = 8;
-
   uint32_t tsr = READ_REG(bsp_can_get_handle(can)->Instance->TSR);
 
   while (((tsr & CAN_TSR_TME0) == 0U) && ((tsr & CAN_TSR_TME1) == 0U) &&
@@ -309,8 +415,37 @@ bsp_status_t bsp_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
     tsr = READ_REG(bsp_can_get_handle(can)->Instance->TSR);
   }
 
-  HAL_StatusTypeDef res = HAL_CAN_AddTxMessage(
-      bsp_can_get_handle(can), &tx_buff[can], data, mailbox + can);
+  return bsp_can_trans_packet_nowait(can, format, id, data);
+}
+
+bsp_status_t bsp_can_trans_packet_nowait(bsp_can_t can,
+                                         bsp_can_format_t format, uint32_t id,
+                                         uint8_t *data) {
+  if (can >= BSP_CAN_BASE_NUM) {
+    return bsp_ext_can_trans_packet_nowait(can, format, id, data);
+  }
+
+  CAN_TxHeaderTypeDef header;
+  uint32_t tx_mailbox = 0;
+
+  if (format == CAN_FORMAT_STD) {
+    header.StdId = id;
+    header.IDE = CAN_ID_STD;
+  } else {
+    header.ExtId = id;
+    header.IDE = CAN_ID_EXT;
+  }
+
+  header.RTR = CAN_RTR_DATA;
+  header.TransmitGlobalTime = DISABLE;
+  header.DLC = 8;
+
+  if (HAL_CAN_GetTxMailboxesFreeLevel(bsp_can_get_handle(can)) == 0) {
+    return BSP_ERR_FULL;
+  }
+
+  HAL_StatusTypeDef res = HAL_CAN_AddTxMessage(bsp_can_get_handle(can), &header,
+                                               data, &tx_mailbox);
 
   if (res == HAL_OK) {
     return BSP_OK;
@@ -318,3 +453,22 @@ bsp_status_t bsp_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
     return BSP_ERR;
   }
 }
+
+/* 外部CAN的发送完成来自串口中断，直接进入临界区 */
+void bsp_can_tx_lock(bsp_can_t can) {
+  if (can >= BSP_CAN_BASE_NUM) {
+    taskENTER_CRITICAL();
+  } else {
+    __HAL_CAN_DISABLE_IT(bsp_can_get_handle(can), CAN_IT_TX_MAILBOX_EMPTY);
+  }
+}
+
+void bsp_can_tx_unlock(bsp_can_t can) {
+  if (can >= BSP_CAN_BASE_NUM) {
+    taskEXIT_CRITICAL();
+  } else {
+    __HAL_CAN_ENABLE_IT(bsp_can_get_handle(can), CAN_IT_TX_MAILBOX_EMPTY);
+  }
+}
+
+uint64_t bsp_can_get_rx_time(bsp_can_t can) { return rx_time[can]; }
@@ -12,9 +12,9 @@ uint64_t bsp_time_get_us() {
   uint32_t ms_new = xTaskGetTickCount();
   uint32_t tick_value_new = SysTick->VAL;
   if (ms_old == ms_new) {
-    return ms_new * 1000 + 1000 - tick_value_old * 1000 / (SysTick->LOAD + 1);
+    return (uint64_t)ms_new * 1000 + 1000 - tick_value_old * 1000 / (SysTick->LOAD + 1);
   } else {
-    return ms_new * 1000 + 1000 - tick_value_new * 1000 / (SysTick->LOAD + 1);
+    return (uint64_t)ms_new * 1000 + 1000 - tick_value_new * 1000 / (SysTick->LOAD + 1);
   }
 }
 
@@ -1,6 +1,7 @@
 #include "bsp_can.h"
 
 #include "bsp_def.h"
+#include "bsp_time.h"
 #include "cmsis_gcc.h"
 #include "main.h"
 #include "stm32g0xx_hal_fdcan.h"
@@ -29,6 +30,9 @@ static bool bsp_can_initd = false;
 
 static can_raw_rx_t rx_buff[BSP_CAN_NUM];
 
+/* 接收中断的进入时间，同一次中断中读出的帧共用 */
+static uint64_t rx_time[BSP_CAN_NUM];
+
 FDCAN_HandleTypeDef *bsp_can_get_handle(bsp_can_t can) {
   switch (can) {
     case BSP_CAN_1:
@@ -107,6 +111,8 @@ static const uint8_t DLCtoBytes[] = {0, 1,  2,  3,  4,  5,  6,  7,
                                      8, 12, 16, 20, 24, 32, 48, 64};
 
 static void can_rx_cb_fn(bsp_can_t can, uint32_t fifo) {
+  rx_time[can] = bsp_time_get_us();
+
   while (HAL_FDCAN_GetRxMessage(bsp_can_get_handle(can), fifo,
                                 &rx_buff[can].header,
                                 rx_buff[can].data) == HAL_OK) {
@@ -130,6 +136,15 @@ static void can_rx_cb_fn(bsp_can_t can, uint32_t fifo) {
   }
 }
 
+void HAL_FDCAN_TxFifoEmptyCallback(FDCAN_HandleTypeDef *hcan) {
+  bsp_can_t can = can_get(hcan);
+
+  if (callback_list[can][CAN_TX_CPLT_CALLBACK].fn) {
+    callback_list[can][CAN_TX_CPLT_CALLBACK].fn(
+        can, 0, NULL, callback_list[can][CAN_TX_CPLT_CALLBACK].arg);
+  }
+}
+
 void HAL_FDCAN_RxFifo0Callback(FDCAN_HandleTypeDef *hcan, uint32_t RxFifo0ITs) {
   (void)RxFifo0ITs;
   can_rx_cb_fn(can_get(hcan), FDCAN_RX_FIFO0);
@@ -140,6 +155,14 @@ void HAL_FDCAN_RxFifo1Callback(FDCAN_HandleTypeDef *hcan, uint32_t RxFifo1ITs) {
   can_rx_cb_fn(can_get(hcan), FDCAN_RX_FIFO1);
 }
 
+/* 暂未使用FDCAN的硬件过滤，接收所有帧，由Device::Can在软件中分发 */
+bsp_status_t bsp_can_add_filter(bsp_can_t can, uint32_t id, uint32_t mask) {
+  (void)can;
+  (void)id;
+  (void)mask;
+  return BSP_OK;
+}
+
 bsp_status_t bsp_can_register_callback(
     bsp_can_t can, bsp_can_callback_t type,
     void (*callback)(bsp_can_t can, uint32_t id, uint8_t *data, void *arg),
@@ -152,8 +175,21 @@ bsp_status_t bsp_can_register_callback(
   return BSP_OK;
 }
 
+static void can_wait_tx_fifo(bsp_can_t can) {
+  while ((bsp_can_get_handle(can)->Instance->TXFQS & FDCAN_TXFQS_TFQF) != 0U) {
+    __NOP();
+  }
+}
+
 bsp_status_t bsp_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
                                   uint32_t id, uint8_t *data) {
+  can_wait_tx_fifo(can);
+  return bsp_can_trans_packet_nowait(can, format, id, data);
+}
+
+bsp_status_t bsp_can_trans_packet_nowait(bsp_can_t can,
+                                         bsp_can_format_t format, uint32_t id,
+                                         uint8_t *data) {
   FDCAN_TxHeaderTypeDef header;
 
   header.Identifier = id;
@@ -171,8 +207,8 @@ bsp_status_t bsp_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
   header.FDFormat = FDCAN_CLASSIC_CAN;
   header.TxEventFifoControl = FDCAN_STORE_TX_EVENTS;
   header.MessageMarker = 0x01;
-  while ((bsp_can_get_handle(can)->Instance->TXFQS & FDCAN_TXFQS_TFQF) != 0U) {
-    __NOP();
+  if ((bsp_can_get_handle(can)->Instance->TXFQS & FDCAN_TXFQS_TFQF) != 0U) {
+    return BSP_ERR_FULL;
   }
 
   return HAL_FDCAN_AddMessageToTxFifoQ(bsp_can_get_handle(can), &header,
@@ -192,6 +228,14 @@ static const uint32_t FDCAN_PACK_LEN_MAP[16] = {
 
 bsp_status_t bsp_canfd_trans_packet(bsp_can_t can, bsp_can_format_t format,
                                     uint32_t id, uint8_t *data, size_t size) {
+  can_wait_tx_fifo(can);
+  return bsp_canfd_trans_packet_nowait(can, format, id, data, size);
+}
+
+bsp_status_t bsp_canfd_trans_packet_nowait(bsp_can_t can,
+                                           bsp_can_format_t format,
+                                           uint32_t id, uint8_t *data,
+                                           size_t size) {
   FDCAN_TxHeaderTypeDef header;
 
   XB_ASSERT(size <= 64);
@@ -223,8 +267,8 @@ bsp_status_t bsp_canfd_trans_packet(bsp_can_t can, bsp_can_format_t format,
   header.FDFormat = FDCAN_FD_CAN;
   header.TxEventFifoControl = FDCAN_STORE_TX_EVENTS;
   header.MessageMarker = 0x01;
-  while ((bsp_can_get_handle(can)->Instance->TXFQS & FDCAN_TXFQS_TFQF) != 0U) {
-    __NOP();
+  if ((bsp_can_get_handle(can)->Instance->TXFQS & FDCAN_TXFQS_TFQF) != 0U) {
+    return BSP_ERR_FULL;
   }
 
   return HAL_FDCAN_AddMessageToTxFifoQ(bsp_can_get_handle(can), &header,
@@ -232,3 +276,13 @@ bsp_status_t bsp_canfd_trans_packet(bsp_can_t can, bsp_can_format_t format,
              ? BSP_OK
              : BSP_ERR;
 }
+
+void bsp_can_tx_lock(bsp_can_t can) {
+  __HAL_FDCAN_DISABLE_IT(bsp_can_get_handle(can), FDCAN_IT_TX_FIFO_EMPTY);
+}
+
+void bsp_can_tx_unlock(bsp_can_t can) {
+  __HAL_FDCAN_ENABLE_IT(bsp_can_get_handle(can), FDCAN_IT_TX_FIFO_EMPTY);
+}
+
+uint64_t bsp_can_get_rx_time(bsp_can_t can) { return rx_time[can]; }
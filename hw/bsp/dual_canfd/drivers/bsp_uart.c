@@ -125,6 +125,22 @@ bsp_status_t bsp_uart_receive(bsp_uart_t uart, uint8_t *buff, size_t size,
   }
 }
 
+bsp_status_t bsp_uart_receive_circular(bsp_uart_t uart, uint8_t *buff,
+                                       size_t size) {
+  UART_HandleTypeDef *huart = bsp_uart_get_handle(uart);
+
+  /* 出错后重新启动时，先停止可能仍在进行的接收 */
+  HAL_UART_AbortReceive(huart);
+
+  /* CubeMX中配置为单次模式，在这里切换为循环模式 */
+  huart->hdmarx->Init.Mode = DMA_CIRCULAR;
+  if (HAL_DMA_Init(huart->hdmarx) != HAL_OK) {
+    return BSP_ERR;
+  }
+
+  return HAL_UART_Receive_DMA(huart, buff, size) != HAL_OK;
+}
+
 uint32_t bsp_uart_get_count(bsp_uart_t uart) {
   return bsp_uart_get_handle(uart)->RxXferSize -
          __HAL_DMA_GET_COUNTER(bsp_uart_get_handle(BSP_UART_MCU)->hdmarx);
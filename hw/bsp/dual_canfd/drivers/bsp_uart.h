@@ -41,6 +41,11 @@ bsp_status_t bsp_uart_transmit(bsp_uart_t uart, uint8_t *data, size_t size,
                                bool block);
 bsp_status_t bsp_uart_receive(bsp_uart_t uart, uint8_t *buff, size_t size,
                               bool block);
+/* 以DMA循环模式持续接收，当前写入位置通过bsp_uart_get_count获取，
+ * 每写满一圈调用一次BSP_UART_RX_CPLT_CB。
+ * 溢出等错误会使HAL停止DMA接收，需要在BSP_UART_ERROR_CB后重新调用 */
+bsp_status_t bsp_uart_receive_circular(bsp_uart_t uart, uint8_t *buff,
+                                       size_t size);
 bsp_status_t bsp_uart_abort_receive(bsp_uart_t uart);
 #ifdef __cplusplus
 }
@@ -18,9 +18,8 @@ uint32_t bsp_time_get_ms() {
 uint64_t bsp_time_get_us() {
   struct timeval tv;
   gettimeofday(&tv, NULL);
-  return ((tv.tv_sec - start_time.tv_sec) * 1000000 +
-          (tv.tv_usec - start_time.tv_usec)) %
-         UINT32_MAX;
+  return (uint64_t)(tv.tv_sec - start_time.tv_sec) * 1000000 +
+         (tv.tv_usec - start_time.tv_usec);
 }
 
 uint64_t bsp_time_get() __attribute__((alias("bsp_time_get_us")));
@@ -37,6 +37,15 @@ typedef struct {
   uint8_t *data;
 } bsp_canfd_data_t;
 
+/* CAN-over-UART桥的接收统计，同一串口上的两路CAN共用 */
+typedef struct {
+  uint64_t rx_byte;   /* 收到的串口字节数 */
+  uint32_t rx_frame;  /* 校验通过的帧数 */
+  uint32_t crc_error; /* 帧头或整帧CRC错误次数 */
+  uint32_t resync;    /* 丢弃数据重新寻找帧头的次数 */
+  uint32_t drop_byte; /* 丢弃的字节数 */
+} bsp_can_bridge_stat_t;
+
 void bsp_can_init(void);
 bsp_status_t bsp_can_register_callback(
     bsp_can_t can, bsp_can_callback_t type,
@@ -45,10 +54,32 @@ bsp_status_t bsp_can_register_callback(
 bsp_status_t bsp_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
                                   uint32_t id, uint8_t *data);
 
+/* 经串口转发时帧头长度字段只有6位，size大于63返回BSP_ERR */
 bsp_status_t bsp_canfd_trans_packet(bsp_can_t can, bsp_can_format_t format,
                                     uint32_t id, uint8_t *data, size_t size);
 
 bsp_status_t bsp_can_get_msg(bsp_can_t can, uint8_t *data, uint32_t *index);
+/* 串口发送缓冲区或SocketCAN发送批次已满时返回BSP_ERR_FULL，
+ * 有空间后通过CAN_TX_CPLT_CALLBACK通知 */
+bsp_status_t bsp_can_trans_packet_nowait(bsp_can_t can,
+                                         bsp_can_format_t format, uint32_t id,
+                                         uint8_t *data);
+bsp_status_t bsp_canfd_trans_packet_nowait(bsp_can_t can,
+                                           bsp_can_format_t format,
+                                           uint32_t id, uint8_t *data,
+                                           size_t size);
+/* 保护Device::Can的发送队列 */
+void bsp_can_tx_lock(bsp_can_t can);
+void bsp_can_tx_unlock(bsp_can_t can);
+/* 硬件接收过滤，标准帧只接收ID满足(id & mask) == (rx_id & mask)的帧，
+ * 扩展帧不过滤。mask为0或过滤器用尽时恢复接收所有帧 */
+bsp_status_t bsp_can_add_filter(bsp_can_t can, uint32_t id, uint32_t mask);
+/* 在接收回调中调用，返回当前帧的到达时间，与bsp_time_get_us()时基相同
+ * 单位：us。SocketCAN优先使用硬件时间戳，串口桥由下位机的接收时间换算 */
+uint64_t bsp_can_get_rx_time(bsp_can_t can);
+/* 获取串口桥接收统计，SocketCAN后端返回BSP_ERR_NO_DEV */
+bsp_status_t bsp_can_get_bridge_stat(bsp_can_t can,
+                                     bsp_can_bridge_stat_t *stat);
 
 #ifdef __cplusplus
 }
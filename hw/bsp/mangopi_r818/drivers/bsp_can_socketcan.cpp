@@ -0,0 +1,501 @@
+#include <errno.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/net_tstamp.h>
+#include <net/if.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <array>
+#include <vector>
+
+#include "bsp_can.h"
+#include "bsp_time.h"
+
+/* 通过SocketCAN访问板载CAN控制器，BSP_CAN_n对应接口can<BASE+n>或vcan<BASE+n>。
+ * 所有接口由一个接收线程通过epoll和recvmmsg批量读取，每条总线一个发送线程
+ * 把积累的帧用sendmmsg一次发出 */
+
+/* 硬件时间戳与bsp_time的偏移取最近两个窗口内的最小值，即接收延迟最小的帧，
+ * 窗口滚动以跟随两个时钟之间的漂移 单位：ns */
+#define SOCKETCAN_TS_WINDOW (1000000000ll)
+
+typedef struct {
+  void (*fn)(bsp_can_t can, uint32_t id, uint8_t *data, void *arg);
+  void *arg;
+} can_callback_t;
+
+typedef struct {
+  int fd;
+  bool opened;
+  bool fd_frames; /* 接口MTU支持CAN FD */
+
+  std::vector<struct can_filter> filter;
+  bool filter_all;
+
+  /* 待发送的帧，由tx_mutex保护 */
+  std::array<struct canfd_frame, BSP_SOCKETCAN_BATCH> tx_frame;
+  std::array<bool, BSP_SOCKETCAN_BATCH> tx_fd;
+  uint32_t tx_num;
+  pthread_mutex_t tx_mutex;
+  pthread_cond_t tx_cond; /* 有帧等待发送 */
+  pthread_cond_t tx_done; /* 一批帧已交给内核 */
+
+  pthread_mutex_t queue_mutex; /* 保护Device::Can的发送队列 */
+
+  int64_t ts_offset;      /* 当前窗口内的最小偏移 */
+  int64_t ts_offset_last; /* 上一个窗口内的最小偏移 */
+  uint64_t ts_window;     /* 当前窗口的起始时间 */
+  uint64_t rx_time;       /* 正在回调的帧的到达时间 单位：us */
+} can_bus_t;
+
+static can_callback_t callback_list[BSP_CAN_NUM][BSP_CAN_CB_NUM];
+
+static std::array<can_bus_t, BSP_CAN_NUM> bus;
+
+static const uint8_t CANFD_LEN[] = {0, 1,  2,  3,  4,  5,  6,  7,
+                                    8, 12, 16, 20, 24, 32, 48, 64};
+
+/* CAN FD只支持固定的几种长度，向上取整后补0 */
+static uint8_t canfd_len(size_t size) {
+  for (uint8_t len : CANFD_LEN) {
+    if (len >= size) {
+      return len;
+    }
+  }
+  return CANFD_MAX_DLEN;
+}
+
+static void can_apply_filter(can_bus_t &can) {
+  if (!can.opened) {
+    return;
+  }
+
+  if (can.filter_all || can.filter.empty()) {
+    struct can_filter all = {.can_id = 0, .can_mask = 0};
+    setsockopt(can.fd, SOL_CAN_RAW, CAN_RAW_FILTER, &all, sizeof(all));
+    return;
+  }
+
+  /* 标准帧按订阅范围过滤，扩展帧全部接收 */
+  std::vector<struct can_filter> list = can.filter;
+  list.push_back({.can_id = CAN_EFF_FLAG, .can_mask = CAN_EFF_FLAG});
+
+  setsockopt(can.fd, SOL_CAN_RAW, CAN_RAW_FILTER, list.data(),
+             static_cast<socklen_t>(list.size() * sizeof(struct can_filter)));
+}
+
+/* 把帧的内核/硬件时间戳换算到bsp_time的时基 */
+static uint64_t can_rx_time(can_bus_t &can, struct msghdr &msg,
+                            uint64_t now_ns, uint64_t real_ns) {
+  struct timespec *ts = NULL;
+
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPING) {
+      ts = reinterpret_cast<struct timespec *>(CMSG_DATA(cmsg));
+    }
+  }
+
+  if (ts == NULL) {
+    return now_ns / 1000;
+  }
+
+  /* ts[2]为硬件时间戳，时钟与系统不同步，用偏移最小值换算 */
+  if (ts[2].tv_sec || ts[2].tv_nsec) {
+    int64_t hw_ns = static_cast<int64_t>(ts[2].tv_sec) * 1000000000ll +
+                    ts[2].tv_nsec;
+    int64_t offset = static_cast<int64_t>(now_ns) - hw_ns;
+
+    if (now_ns - can.ts_window > SOCKETCAN_TS_WINDOW) {
+      can.ts_offset_last = can.ts_offset;
+      can.ts_offset = INT64_MAX;
+      can.ts_window = now_ns;
+    }
+
+    if (offset < can.ts_offset) {
+      can.ts_offset = offset;
+    }
+
+    offset = can.ts_offset < can.ts_offset_last ? can.ts_offset
+                                                 : can.ts_offset_last;
+    return static_cast<uint64_t>(hw_ns + offset) / 1000;
+  }
+
+  /* ts[0]为软件时间戳(CLOCK_REALTIME)，按帧已经等待的时间回推 */
+  uint64_t sw_ns =
+      static_cast<uint64_t>(ts[0].tv_sec) * 1000000000ull + ts[0].tv_nsec;
+  if (sw_ns == 0 || sw_ns > real_ns || real_ns - sw_ns > now_ns) {
+    return now_ns / 1000;
+  }
+
+  return (now_ns - (real_ns - sw_ns)) / 1000;
+}
+
+static void can_dispatch(bsp_can_t id, struct canfd_frame &frame,
+                         ssize_t len) {
+  if (frame.can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG)) {
+    return;
+  }
+
+  uint32_t index = (frame.can_id & CAN_EFF_FLAG)
+                       ? (frame.can_id & CAN_EFF_MASK)
+                       : (frame.can_id & CAN_SFF_MASK);
+
+  if (len == CANFD_MTU) {
+    can_callback_t &cb = callback_list[id][CANFD_RX_MSG_CALLBACK];
+    if (cb.fn) {
+      bsp_canfd_data_t data = {.size = frame.len, .data = frame.data};
+      cb.fn(id, index, reinterpret_cast<uint8_t *>(&data), cb.arg);
+    }
+  } else {
+    can_callback_t &cb = callback_list[id][CAN_RX_MSG_CALLBACK];
+    if (cb.fn) {
+      if (frame.len < CAN_MAX_DLEN) {
+        memset(frame.data + frame.len, 0, CAN_MAX_DLEN - frame.len);
+      }
+      cb.fn(id, index, frame.data, cb.arg);
+    }
+  }
+}
+
+static void *can_rx_thread_fn(void *arg) {
+  int epfd = *static_cast<int *>(arg);
+
+  static std::array<struct canfd_frame, BSP_SOCKETCAN_BATCH> frame;
+  static std::array<struct iovec, BSP_SOCKETCAN_BATCH> iov;
+  static std::array<struct mmsghdr, BSP_SOCKETCAN_BATCH> msg;
+  static std::array<std::array<char, CMSG_SPACE(3 * sizeof(struct timespec))>,
+                    BSP_SOCKETCAN_BATCH>
+      control;
+
+  struct epoll_event events[BSP_CAN_NUM];
+
+  while (true) {
+    int ready = epoll_wait(epfd, events, BSP_CAN_NUM, -1);
+
+    for (int i = 0; i < ready; i++) {
+      bsp_can_t id = static_cast<bsp_can_t>(events[i].data.u32);
+      can_bus_t &can = bus[id];
+
+      for (int j = 0; j < BSP_SOCKETCAN_BATCH; j++) {
+        iov[j].iov_base = &frame[j];
+        iov[j].iov_len = sizeof(frame[j]);
+        memset(&msg[j], 0, sizeof(msg[j]));
+        msg[j].msg_hdr.msg_iov = &iov[j];
+        msg[j].msg_hdr.msg_iovlen = 1;
+        msg[j].msg_hdr.msg_control = control[j].data();
+        msg[j].msg_hdr.msg_controllen = control[j].size();
+      }
+
+      int num = recvmmsg(can.fd, msg.data(), BSP_SOCKETCAN_BATCH,
+                         MSG_DONTWAIT, NULL);
+      if (num <= 0) {
+        continue;
+      }
+
+      /* 一批帧共用同一组参考时间 */
+      uint64_t now_ns = bsp_time_get_ns();
+      struct timespec real;
+      clock_gettime(CLOCK_REALTIME, &real);
+      uint64_t real_ns =
+          static_cast<uint64_t>(real.tv_sec) * 1000000000ull + real.tv_nsec;
+
+      for (int j = 0; j < num; j++) {
+        ssize_t len = msg[j].msg_len;
+        if (len != CAN_MTU && len != CANFD_MTU) {
+          continue;
+        }
+
+        can.rx_time = can_rx_time(can, msg[j].msg_hdr, now_ns, real_ns);
+        can_dispatch(id, frame[j], len);
+      }
+    }
+  }
+
+  return static_cast<void *>(0);
+}
+
+static void *can_tx_thread_fn(void *arg) {
+  bsp_can_t id = *static_cast<bsp_can_t *>(arg);
+  can_bus_t &can = bus[id];
+
+  std::array<struct canfd_frame, BSP_SOCKETCAN_BATCH> frame;
+  std::array<struct iovec, BSP_SOCKETCAN_BATCH> iov;
+  std::array<struct mmsghdr, BSP_SOCKETCAN_BATCH> msg;
+
+  while (true) {
+    pthread_mutex_lock(&can.tx_mutex);
+    while (can.tx_num == 0) {
+      pthread_cond_wait(&can.tx_cond, &can.tx_mutex);
+    }
+
+    uint32_t num = can.tx_num;
+    for (uint32_t i = 0; i < num; i++) {
+      frame[i] = can.tx_frame[i];
+      iov[i].iov_base = &frame[i];
+      iov[i].iov_len = can.tx_fd[i] ? CANFD_MTU : CAN_MTU;
+      memset(&msg[i], 0, sizeof(msg[i]));
+      msg[i].msg_hdr.msg_iov = &iov[i];
+      msg[i].msg_hdr.msg_iovlen = 1;
+    }
+    can.tx_num = 0;
+    pthread_mutex_unlock(&can.tx_mutex);
+
+    uint32_t sent = 0;
+    while (sent < num) {
+      int ans = sendmmsg(can.fd, msg.data() + sent, num - sent, 0);
+      if (ans > 0) {
+        sent += ans;
+        continue;
+      }
+
+      /* 内核发送队列已满，等待可写后重试 */
+      if (ans < 0 && (errno == ENOBUFS || errno == EAGAIN)) {
+        struct pollfd pfd = {.fd = can.fd, .events = POLLOUT, .revents = 0};
+        poll(&pfd, 1, 1);
+        continue;
+      }
+
+      break;
+    }
+
+    pthread_mutex_lock(&can.tx_mutex);
+    pthread_cond_broadcast(&can.tx_done);
+    pthread_mutex_unlock(&can.tx_mutex);
+
+    /* 通知Device::Can继续发出发送队列中的帧 */
+    can_callback_t &cb = callback_list[id][CAN_TX_CPLT_CALLBACK];
+    if (cb.fn) {
+      pthread_mutex_lock(&can.queue_mutex);
+      cb.fn(id, 0, NULL, cb.arg);
+      pthread_mutex_unlock(&can.queue_mutex);
+    }
+  }
+
+  return static_cast<void *>(0);
+}
+
+static int can_open(bsp_can_t id) {
+  char name[IFNAMSIZ];
+  snprintf(name, sizeof(name), "%s%d", BSP_SOCKETCAN_VCAN ? "vcan" : "can",
+           BSP_SOCKETCAN_IF_BASE + id);
+
+  int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+  if (fd < 0) {
+    printf("SocketCAN: can not create socket for %s.\r\n", name);
+    return -1;
+  }
+
+  struct ifreq ifr = {};
+  strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+  if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+    printf("SocketCAN: interface %s not found.\r\n", name);
+    close(fd);
+    return -1;
+  }
+
+  /* ifr_ifindex与ifr_mtu共用同一块内存，查询MTU前先保存 */
+  int ifindex = ifr.ifr_ifindex;
+
+  int enable = 1;
+  bus[id].fd_frames = setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable,
+                                 sizeof(enable)) == 0;
+  if (bus[id].fd_frames && ioctl(fd, SIOCGIFMTU, &ifr) == 0) {
+    bus[id].fd_frames = ifr.ifr_mtu == CANFD_MTU;
+  }
+
+  int flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE |
+              SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+  setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+
+  struct sockaddr_can addr = {};
+  addr.can_family = AF_CAN;
+  addr.can_ifindex = ifindex;
+  if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+    printf("SocketCAN: can not bind %s.\r\n", name);
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+void bsp_can_init(void) {
+  static std::array<bsp_can_t, BSP_CAN_NUM> id;
+  static int epfd = epoll_create1(0);
+
+  for (int i = 0; i < BSP_CAN_NUM; i++) {
+    can_bus_t &can = bus[i];
+    id[i] = static_cast<bsp_can_t>(i);
+
+    pthread_mutex_init(&can.tx_mutex, NULL);
+    pthread_cond_init(&can.tx_cond, NULL);
+    pthread_cond_init(&can.tx_done, NULL);
+    pthread_mutex_init(&can.queue_mutex, NULL);
+    can.ts_offset = INT64_MAX;
+    can.ts_offset_last = INT64_MAX;
+
+    can.fd = can_open(id[i]);
+    if (can.fd < 0) {
+      continue;
+    }
+    can.opened = true;
+
+    can_apply_filter(can);
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u32 = i;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, can.fd, &event);
+
+    pthread_t tx_thread;
+    pthread_create(&tx_thread, NULL, can_tx_thread_fn, &id[i]);
+  }
+
+  pthread_t rx_thread;
+  pthread_create(&rx_thread, NULL, can_rx_thread_fn, &epfd);
+}
+
+bsp_status_t bsp_can_register_callback(
+    bsp_can_t can, bsp_can_callback_t type,
+    void (*callback)(bsp_can_t can, uint32_t id, uint8_t *data, void *arg),
+    void *callback_arg) {
+  XB_ASSERT(callback);
+  XB_ASSERT(type != BSP_CAN_CB_NUM);
+
+  callback_list[can][type].fn = callback;
+  callback_list[can][type].arg = callback_arg;
+  return BSP_OK;
+}
+
+/* 内核过滤器数量不受限制，按订阅范围逐条添加 */
+bsp_status_t bsp_can_add_filter(bsp_can_t can, uint32_t id, uint32_t mask) {
+  can_bus_t &bus_can = bus[can];
+
+  if (mask == 0) {
+    bus_can.filter_all = true;
+  } else if (!bus_can.filter_all) {
+    struct can_filter filter = {
+        .can_id = id & CAN_SFF_MASK,
+        .can_mask = (mask & CAN_SFF_MASK) | CAN_EFF_FLAG | CAN_RTR_FLAG};
+
+    for (auto &item : bus_can.filter) {
+      if (item.can_id == filter.can_id && item.can_mask == filter.can_mask) {
+        return BSP_OK;
+      }
+    }
+
+    bus_can.filter.push_back(filter);
+  }
+
+  can_apply_filter(bus_can);
+
+  return BSP_OK;
+}
+
+static bsp_status_t can_tx_push(bsp_can_t id, bsp_can_format_t format,
+                                uint32_t index, uint8_t *data, size_t size,
+                                bool fd) {
+  can_bus_t &can = bus[id];
+
+  if (!can.opened) {
+    return BSP_ERR_NO_DEV;
+  }
+
+  if (fd && (!can.fd_frames || size > CANFD_MAX_DLEN)) {
+    return BSP_ERR;
+  }
+
+  pthread_mutex_lock(&can.tx_mutex);
+
+  if (can.tx_num == BSP_SOCKETCAN_BATCH) {
+    pthread_mutex_unlock(&can.tx_mutex);
+    return BSP_ERR_FULL;
+  }
+
+  struct canfd_frame &frame = can.tx_frame[can.tx_num];
+  memset(&frame, 0, sizeof(frame));
+  if (format == CAN_FORMAT_EXT) {
+    frame.can_id = (index & CAN_EFF_MASK) | CAN_EFF_FLAG;
+  } else {
+    frame.can_id = index & CAN_SFF_MASK;
+  }
+  frame.len = fd ? canfd_len(size) : static_cast<uint8_t>(size);
+  frame.flags = fd ? CANFD_BRS : 0;
+  memcpy(frame.data, data, size);
+  can.tx_fd[can.tx_num] = fd;
+
+  if (can.tx_num++ == 0) {
+    pthread_cond_signal(&can.tx_cond);
+  }
+
+  pthread_mutex_unlock(&can.tx_mutex);
+
+  return BSP_OK;
+}
+
+/* 发送批次已满时等待发送线程取走 */
+static bsp_status_t can_tx_wait(bsp_can_t id, bsp_can_format_t format,
+                                uint32_t index, uint8_t *data, size_t size,
+                                bool fd) {
+  can_bus_t &can = bus[id];
+
+  while (true) {
+    bsp_status_t ans = can_tx_push(id, format, index, data, size, fd);
+    if (ans != BSP_ERR_FULL) {
+      return ans;
+    }
+
+    pthread_mutex_lock(&can.tx_mutex);
+    while (can.tx_num == BSP_SOCKETCAN_BATCH) {
+      pthread_cond_wait(&can.tx_done, &can.tx_mutex);
+    }
+    pthread_mutex_unlock(&can.tx_mutex);
+  }
+}
+
+bsp_status_t bsp_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
+                                  uint32_t id, uint8_t *data) {
+  return can_tx_wait(can, format, id, data, CAN_MAX_DLEN, false);
+}
+
+bsp_status_t bsp_canfd_trans_packet(bsp_can_t can, bsp_can_format_t format,
+                                    uint32_t id, uint8_t *data, size_t size) {
+  return can_tx_wait(can, format, id, data, size, true);
+}
+
+bsp_status_t bsp_can_trans_packet_nowait(bsp_can_t can,
+                                         bsp_can_format_t format, uint32_t id,
+                                         uint8_t *data) {
+  return can_tx_push(can, format, id, data, CAN_MAX_DLEN, false);
+}
+
+bsp_status_t bsp_canfd_trans_packet_nowait(bsp_can_t can,
+                                           bsp_can_format_t format,
+                                           uint32_t id, uint8_t *data,
+                                           size_t size) {
+  return can_tx_push(can, format, id, data, size, true);
+}
+
+void bsp_can_tx_lock(bsp_can_t can) {
+  pthread_mutex_lock(&bus[can].queue_mutex);
+}
+
+void bsp_can_tx_unlock(bsp_can_t can) {
+  pthread_mutex_unlock(&bus[can].queue_mutex);
+}
+
+uint64_t bsp_can_get_rx_time(bsp_can_t can) { return bus[can].rx_time; }
+
+bsp_status_t bsp_can_get_bridge_stat(bsp_can_t can,
+                                     bsp_can_bridge_stat_t *stat) {
+  (void)can;
+  (void)stat;
+  return BSP_ERR_NO_DEV;
+}
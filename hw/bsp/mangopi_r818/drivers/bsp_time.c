@@ -1,25 +1,129 @@
 #include "bsp_time.h"
 
-#include <sys/time.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
 
-static struct timeval start_time;
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
 
-void bsp_time_init() { gettimeofday(&start_time, NULL); }
+/* 所有接口返回自bsp_time_init()起经过的时间，基于CLOCK_MONOTONIC_RAW，
+ * 不受系统对时影响，64位计数不会回绕 */
+static uint64_t start_time = 0;
 
-uint32_t bsp_time_get_ms() {
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  return ((tv.tv_sec - start_time.tv_sec) * 1000 +
-          (tv.tv_usec - start_time.tv_usec) / 1000) %
-         UINT32_MAX;
+#if LINUX_TIME_FAST_COUNTER && (defined(__x86_64__) || defined(__aarch64__))
+#define BSP_TIME_COUNTER 1
+#else
+#define BSP_TIME_COUNTER 0
+#endif
+
+#if BSP_TIME_COUNTER
+/* ns = counter_base_ns + ((counter - counter_base) * counter_mult) >> 32 */
+static bool counter_valid = false;
+static uint64_t counter_base = 0;
+static uint64_t counter_base_ns = 0;
+static uint64_t counter_mult = 0;
+#endif
+
+static uint64_t clock_get_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+#if BSP_TIME_COUNTER
+static inline uint64_t counter_read() {
+#if defined(__x86_64__)
+  return __rdtsc();
+#else
+  uint64_t val;
+  __asm__ volatile("isb\n mrs %0, cntvct_el0" : "=r"(val));
+  return val;
+#endif
+}
+
+/* 只有内核自己也在用该计数器作为时钟源时，才认为它是恒频且各核同步的 */
+static bool counter_check() {
+  char buff[32] = {0};
+  FILE *fp = fopen(
+      "/sys/devices/system/clocksource/clocksource0/current_clocksource", "r");
+  if (fp == NULL) {
+    return false;
+  }
+
+  bool ans = fgets(buff, sizeof(buff), fp) != NULL;
+  fclose(fp);
+
+#if defined(__x86_64__)
+  return ans && strncmp(buff, "tsc", 3) == 0;
+#else
+  return ans && strncmp(buff, "arch_sys_counter", 16) == 0;
+#endif
+}
+
+static void counter_init() {
+  if (!counter_check()) {
+    return;
+  }
+
+#if defined(__x86_64__)
+  /* 用CLOCK_MONOTONIC_RAW标定TSC频率 */
+  uint64_t ns_start = clock_get_ns();
+  uint64_t tick_start = counter_read();
+
+  struct timespec ts = {.tv_sec = 0, .tv_nsec = 20000000};
+  nanosleep(&ts, NULL);
+
+  uint64_t ns_end = clock_get_ns();
+  uint64_t tick_end = counter_read();
+
+  if (tick_end <= tick_start) {
+    return;
+  }
+
+  counter_mult = (uint64_t)(((unsigned __int128)(ns_end - ns_start) << 32) /
+                            (tick_end - tick_start));
+#else
+  uint64_t freq;
+  __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+
+  if (freq == 0) {
+    return;
+  }
+
+  counter_mult = (uint64_t)(((unsigned __int128)1000000000u << 32) / freq);
+#endif
+
+  counter_base_ns = clock_get_ns();
+  counter_base = counter_read();
+  counter_valid = true;
 }
+#endif
 
-uint64_t bsp_time_get_us() {
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  return ((tv.tv_sec - start_time.tv_sec) * 1000000 +
-          (tv.tv_usec - start_time.tv_usec)) %
-         UINT32_MAX;
+void bsp_time_init() {
+  start_time = clock_get_ns();
+
+#if BSP_TIME_COUNTER
+  counter_init();
+#endif
+}
+
+uint64_t bsp_time_get_ns() {
+#if BSP_TIME_COUNTER
+  if (counter_valid) {
+    uint64_t delta = counter_read() - counter_base;
+    return counter_base_ns - start_time +
+           (uint64_t)(((unsigned __int128)delta * counter_mult) >> 32);
+  }
+#endif
+
+  return clock_get_ns() - start_time;
 }
 
+uint32_t bsp_time_get_ms() { return (uint32_t)(bsp_time_get_ns() / 1000000); }
+
+uint64_t bsp_time_get_us() { return bsp_time_get_ns() / 1000; }
+
 uint64_t bsp_time_get() __attribute__((alias("bsp_time_get_us")));
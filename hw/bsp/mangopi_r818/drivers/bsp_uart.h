@@ -30,10 +30,17 @@ bsp_status_t bsp_uart_register_callback(bsp_uart_t uart,
                                         bsp_uart_callback_t type,
                                         void (*callback)(void *),
                                         void *callback_arg);
+/* 数据复制到发送缓冲区后由IO线程发出。block为false时立即返回，
+ * 缓冲区空间不足返回BSP_ERR_FULL；block为true时等待数据全部写入设备。
+ * 缓冲区中的数据全部发出后调用BSP_UART_TX_CPLT_CB，连续的多次发送只回调一次 */
 bsp_status_t bsp_uart_transmit(bsp_uart_t uart, uint8_t *data, size_t size,
                                bool block);
 bsp_status_t bsp_uart_receive(bsp_uart_t uart, uint8_t *buff, size_t size,
                               bool block);
+/* 等待数据到达，一次读出当前已收到的全部数据(最多size字节)，不要求读满。
+ * 实际长度通过bsp_uart_get_count获取，timeout单位：ms，超时返回BSP_ERR_TIMEOUT */
+bsp_status_t bsp_uart_receive_some(bsp_uart_t uart, uint8_t *buff, size_t size,
+                                   uint32_t timeout);
 bsp_status_t bsp_uart_abort_receive(bsp_uart_t uart);
 #ifdef __cplusplus
 }
@@ -1,6 +1,7 @@
 #include "bsp_can.h"
 
 #include "FreeRTOS.h"
+#include "bsp_time.h"
 #include "main.h"
 #include "semphr.h"
 #include "task.h"
@@ -26,10 +27,11 @@ static can_callback_t callback_list[BSP_CAN_NUM][BSP_CAN_CB_NUM];
 
 static bool bsp_can_initd = false;
 
-static uint32_t mailbox[BSP_CAN_NUM];
-
 static can_raw_rx_t rx_buff[BSP_CAN_NUM];
 
+/* 接收中断的进入时间，同一次中断中读出的帧共用 */
+static uint64_t rx_time[BSP_CAN_NUM];
+
 static SemaphoreHandle_t rx_cplt_wait_sem[BSP_CAN_NUM];
 
 CAN_HandleTypeDef *bsp_can_get_handle(bsp_can_t can) {
@@ -49,7 +51,16 @@ static bsp_can_t can_get(CAN_HandleTypeDef *hcan) {
   }
 }
 
+static void can_tx_cplt_cb_fn(bsp_can_t can) {
+  if (callback_list[can][CAN_TX_CPLT_CALLBACK].fn) {
+    callback_list[can][CAN_TX_CPLT_CALLBACK].fn(
+        can, 0, NULL, callback_list[can][CAN_TX_CPLT_CALLBACK].arg);
+  }
+}
+
 void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) {
+  can_tx_cplt_cb_fn(can_get(hcan));
+
   BaseType_t px_higher_priority_task_woken = 0;
   xSemaphoreGiveFromISR(rx_cplt_wait_sem[can_get(hcan)],
                         &px_higher_priority_task_woken);
@@ -59,6 +70,8 @@ void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) {
 }
 
 void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan) {
+  can_tx_cplt_cb_fn(can_get(hcan));
+
   BaseType_t px_higher_priority_task_woken = 0;
   xSemaphoreGiveFromISR(rx_cplt_wait_sem[can_get(hcan)],
                         &px_higher_priority_task_woken);
@@ -68,6 +81,8 @@ void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan) {
 }
 
 void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan) {
+  can_tx_cplt_cb_fn(can_get(hcan));
+
   BaseType_t px_higher_priority_task_woken = 0;
   xSemaphoreGiveFromISR(rx_cplt_wait_sem[can_get(hcan)],
                         &px_higher_priority_task_woken);
@@ -116,6 +131,8 @@ void bsp_can_init(void) {
 }
 
 static void can_rx_cb_fn(bsp_can_t can) {
+  rx_time[can] = bsp_time_get_us();
+
   uint32_t fifo = CAN_FILTER_FIFO0;
 
   if (callback_list[can][CAN_RX_MSG_CALLBACK].fn) {
@@ -139,6 +156,70 @@ void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) {
   can_rx_cb_fn(can_get(hcan));
 }
 
+/* 每个CAN可用的过滤器组数量，第一组在启用过滤后只放行扩展帧 */
+#define BSP_CAN_FILTER_NUM (14)
+
+static uint8_t filter_num[BSP_CAN_NUM];
+static bool filter_all[BSP_CAN_NUM];
+static uint32_t filter_list[BSP_CAN_NUM][BSP_CAN_FILTER_NUM][2];
+
+static void can_config_filter(bsp_can_t can, uint32_t index, uint32_t id_high,
+                              uint32_t id_low, uint32_t mask_high,
+                              uint32_t mask_low) {
+  uint32_t bank = 0;
+  uint32_t fifo = CAN_FILTER_FIFO0;
+
+  CAN_FilterTypeDef can_filter = {0};
+
+  can_filter.FilterBank = bank + index;
+  can_filter.FilterIdHigh = id_high;
+  can_filter.FilterIdLow = id_low;
+  can_filter.FilterMode = CAN_FILTERMODE_IDMASK;
+  can_filter.FilterScale = CAN_FILTERSCALE_32BIT;
+  can_filter.FilterMaskIdHigh = mask_high;
+  can_filter.FilterMaskIdLow = mask_low;
+  can_filter.FilterActivation = ENABLE;
+  can_filter.SlaveStartFilterBank = 14;
+  can_filter.FilterFIFOAssignment = fifo;
+
+  HAL_CAN_ConfigFilter(bsp_can_get_handle(can), &can_filter);
+}
+
+bsp_status_t bsp_can_add_filter(bsp_can_t can, uint32_t id, uint32_t mask) {
+  if (filter_all[can]) {
+    return BSP_OK;
+  }
+
+  mask &= 0x7ff;
+  id &= mask;
+
+  for (int i = 1; i <= filter_num[can]; i++) {
+    if (filter_list[can][i][0] == id && filter_list[can][i][1] == mask) {
+      return BSP_OK;
+    }
+  }
+
+  /* 第0组用于只放行扩展帧，第1到BSP_CAN_FILTER_NUM - 1组用于标准帧ID */
+  if (mask == 0 || filter_num[can] >= BSP_CAN_FILTER_NUM - 1) {
+    /* 第一组恢复为接收所有帧，其余过滤器都是它的子集，无需关闭 */
+    filter_all[can] = true;
+    can_config_filter(can, 0, 0, 0, 0, 0);
+    return mask == 0 ? BSP_OK : BSP_ERR_FULL;
+  }
+
+  /* 32位掩码模式下STID位于高16位的[15:5]，IDE位于低16位的bit2 */
+  filter_num[can]++;
+  filter_list[can][filter_num[can]][0] = id;
+  filter_list[can][filter_num[can]][1] = mask;
+  can_config_filter(can, filter_num[can], id << 5, 0, mask << 5, CAN_ID_EXT);
+
+  if (filter_num[can] == 1) {
+    can_config_filter(can, 0, 0, CAN_ID_EXT, 0, CAN_ID_EXT);
+  }
+
+  return BSP_OK;
+}
+
 bsp_status_t bsp_can_register_callback(
     bsp_can_t can, bsp_can_callback_t type,
     void (*callback)(bsp_can_t can, uint32_t id, uint8_t *data, void *arg),
@@ -153,7 +234,22 @@ bsp_status_t bsp_can_register_callback(
 
 bsp_status_t bsp_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
                                   uint32_t id, uint8_t *data) {
+  uint32_t tsr = READ_REG(bsp_can_get_handle(can)->Instance->TSR);
+
+  while (((tsr & CAN_TSR_TME0) == 0U) && ((tsr & CAN_TSR_TME1) == 0U) &&
+         ((tsr & CAN_TSR_TME2) == 0U)) {
+    xSemaphoreTake(rx_cplt_wait_sem[can], 1);
+    tsr = READ_REG(bsp_can_get_handle(can)->Instance->TSR);
+  }
+
+  return bsp_can_trans_packet_nowait(can, format, id, data);
+}
+
+bsp_status_t bsp_can_trans_packet_nowait(bsp_can_t can,
+                                         bsp_can_format_t format, uint32_t id,
+                                         uint8_t *data) {
   CAN_TxHeaderTypeDef header;
+  uint32_t tx_mailbox = 0;
 
   if (format == CAN_FORMAT_STD) {
     header.StdId = id;
@@ -167,16 +263,12 @@ bsp_status_t bsp_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
   header.TransmitGlobalTime = DISABLE;
   header.DLC = 8;
 
-  uint32_t tsr = READ_REG(bsp_can_get_handle(can)->Instance->TSR);
-
-  while (((tsr & CAN_TSR_TME0) == 0U) && ((tsr & CAN_TSR_TME1) == 0U) &&
-         ((tsr & CAN_TSR_TME2) == 0U)) {
-    xSemaphoreTake(rx_cplt_wait_sem[can], 1);
-    tsr = READ_REG(bsp_can_get_handle(can)->Instance->TSR);
+  if (HAL_CAN_GetTxMailboxesFreeLevel(bsp_can_get_handle(can)) == 0) {
+    return BSP_ERR_FULL;
   }
 
   HAL_StatusTypeDef res = HAL_CAN_AddTxMessage(bsp_can_get_handle(can), &header,
-                                               data, mailbox + can);
+                                               data, &tx_mailbox);
 
   if (res == HAL_OK) {
     return BSP_OK;
@@ -185,6 +277,14 @@ bsp_status_t bsp_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
   }
 }
 
+void bsp_can_tx_lock(bsp_can_t can) {
+  __HAL_CAN_DISABLE_IT(bsp_can_get_handle(can), CAN_IT_TX_MAILBOX_EMPTY);
+}
+
+void bsp_can_tx_unlock(bsp_can_t can) {
+  __HAL_CAN_ENABLE_IT(bsp_can_get_handle(can), CAN_IT_TX_MAILBOX_EMPTY);
+}
+
 bsp_status_t bsp_can_get_msg(bsp_can_t can, uint8_t *data, uint32_t *index) {
   can_raw_rx_t rx = {};
   HAL_StatusTypeDef res = HAL_OK;
@@ -206,3 +306,5 @@ bsp_status_t bsp_can_get_msg(bsp_can_t can, uint8_t *data, uint32_t *index) {
 
   return BSP_ERR;
 }
+
+uint64_t bsp_can_get_rx_time(bsp_can_t can) { return rx_time[can]; }
@@ -32,6 +32,19 @@ bsp_status_t bsp_can_register_callback(
 bsp_status_t bsp_can_trans_packet(bsp_can_t can, bsp_can_format_t format,
                                   uint32_t id, uint8_t *data);
 bsp_status_t bsp_can_get_msg(bsp_can_t can, uint8_t *data, uint32_t *index);
+/* 不等待发送邮箱，邮箱已满时返回BSP_ERR_FULL，可在中断中调用 */
+bsp_status_t bsp_can_trans_packet_nowait(bsp_can_t can,
+                                         bsp_can_format_t format, uint32_t id,
+                                         uint8_t *data);
+/* 屏蔽/恢复发送完成中断，用于保护在发送完成回调中访问的发送队列 */
+void bsp_can_tx_lock(bsp_can_t can);
+void bsp_can_tx_unlock(bsp_can_t can);
+/* 硬件接收过滤，标准帧只接收ID满足(id & mask) == (rx_id & mask)的帧，
+ * 扩展帧不过滤。mask为0或过滤器用尽时恢复接收所有帧 */
+bsp_status_t bsp_can_add_filter(bsp_can_t can, uint32_t id, uint32_t mask);
+/* 在接收回调中调用，返回当前帧的到达时间，与bsp_time_get_us()时基相同
+ * 单位：us。取自接收中断的进入时间 */
+uint64_t bsp_can_get_rx_time(bsp_can_t can);
 
 #ifdef __cplusplus
 }
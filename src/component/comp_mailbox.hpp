@@ -0,0 +1,107 @@
+/*
+  只保留最新数据的邮箱
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+namespace Component {
+/* 单写单读，用于接收中断向控制线程传递反馈帧。
+ * 两个槽交替写入，每个槽带一个序号，写入期间为奇数。写入不等待；
+ * 读取只在复制期间同一个槽被再次写入(连续写入两次)时重试。
+ * 不使用互斥锁或原子读改写，Cortex-M0+上也可以使用 */
+template <typename Data>
+class Mailbox {
+ public:
+  static_assert(std::is_trivially_copyable<Data>::value,
+                "Mailbox data must be trivially copyable");
+
+  Mailbox() : latest_(0) {
+    for (auto& slot : slot_) {
+      slot.seq.store(0, std::memory_order_relaxed);
+      slot.count = 0;
+    }
+  }
+
+  /* 写入最新数据，可在中断中调用，同一时刻只能有一个写入者 */
+  void Write(const Data& data) {
+    uint8_t index = latest_.load(std::memory_order_relaxed) ^ 1;
+    Slot& slot = slot_[index];
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.data = data;
+    slot.count = write_count_ + 1;
+
+    slot.seq.store(seq + 2, std::memory_order_release);
+    latest_.store(index, std::memory_order_release);
+
+    write_count_++;
+  }
+
+  /* 读取最新数据，自上次读取后没有写入时返回false，data保持不变 */
+  bool Read(Data& data) {
+    Data tmp;
+    uint32_t count = 0;
+
+    while (true) {
+      const Slot& slot = slot_[latest_.load(std::memory_order_acquire)];
+      uint32_t seq = slot.seq.load(std::memory_order_acquire);
+
+      if (seq & 1) {
+        continue;
+      }
+
+      count = slot.count;
+      if (count == read_count_) {
+        stale_++;
+        return false;
+      }
+
+      tmp = slot.data;
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) == seq) {
+        break;
+      }
+    }
+
+    overwrite_ += count - read_count_ - 1;
+    read_count_ = count;
+    stale_ = 0;
+    data = tmp;
+
+    return true;
+  }
+
+  /* 连续读取到旧数据的次数，读取到新数据时清零 */
+  uint32_t Stale() const { return stale_; }
+
+  /* 未被读取就被覆盖的数据数量 */
+  uint32_t Overwrite() const { return overwrite_; }
+
+ private:
+  typedef struct {
+    std::atomic<uint32_t> seq;
+    uint32_t count; /* 该槽数据的写入序号，从1开始 */
+    Data data;
+  } Slot;
+
+  Slot slot_[2];
+
+  std::atomic<uint8_t> latest_;
+
+  /* 只由写入者访问 */
+  uint32_t write_count_ = 0;
+
+  /* 只由读取者访问 */
+  uint32_t read_count_ = 0;
+  uint32_t stale_ = 0;
+  uint32_t overwrite_ = 0;
+};
+}  // namespace Component
@@ -1,19 +1,222 @@
 #include "dev_can.hpp"
 
 #include "bsp_can.h"
+#include "bsp_time.h"
 
 using namespace Device;
 
+/* 每条总线上单独统计的ID表最多使用3/4，超出的ID合并统计 */
+#define DEV_CAN_ID_STAT_SIZE (1u << DEVICE_CAN_STAT_ID_BITS)
+
+/* 统计数据更新周期 单位：ms */
+#define DEV_CAN_STAT_CYCLE (1000)
+
+/* 不含位填充的帧长度 单位：bit */
+#define DEV_CAN_STD_FRAME_BITS (47 + 8 * 8)
+#define DEV_CAN_EXT_FRAME_BITS (67 + 8 * 8)
+
+typedef struct {
+  uint32_t key;      /* 仲裁优先级，越小越先发送 */
+  uint32_t deadline; /* 单位：ms */
+  bool has_deadline;
+  bsp_can_format_t format;
+  Can::Pack pack;
+} TxFrame;
+
+/* order是frame的下标排列，前size项为队列中的帧，按发送顺序从后往前排列，
+ * 其余为空闲位置 */
+typedef struct {
+  TxFrame frame[DEVICE_CAN_TX_QUEUE_LEN];
+  uint8_t order[DEVICE_CAN_TX_QUEUE_LEN];
+  uint8_t size;
+} TxQueue;
+
+typedef struct {
+  std::atomic<bool> used;
+  uint32_t id;
+  uint32_t count;      /* 累计收发帧数 */
+  uint32_t last_count; /* 上次更新速率时的count */
+  uint32_t rate;       /* 单位：帧/s */
+  uint32_t drop;       /* 队列已满被丢弃 */
+  uint32_t timeout;    /* 超过有效期未发出被丢弃 */
+  uint32_t last_time;  /* 上次接收的时间 单位：us */
+  int32_t interval;    /* 上次接收间隔 单位：us */
+  int32_t period;      /* 平均接收间隔的16倍 单位：us */
+  int32_t jitter;      /* 接收间隔抖动的16倍，按RFC 3550平滑 单位：us */
+} IdStat;
+
+/* 开放寻址的ID统计表，只在接收中断或持有发送锁时写入，不会并发插入 */
+typedef struct {
+  IdStat slot[DEV_CAN_ID_STAT_SIZE];
+  uint32_t used;
+  IdStat other;
+} IdTable;
+
+typedef struct {
+  uint32_t frame;
+  uint32_t byte;
+  uint32_t bit;
+} Counter;
+
+typedef struct {
+  Counter rx, tx;
+  Counter last_rx, last_tx;
+  uint32_t error; /* 发送失败 */
+  uint8_t queue_max;
+  uint64_t last_time; /* 上次更新统计数据的时间 单位：us */
+  IdTable rx_id, tx_id;
+} BusStat;
+
+static std::array<TxQueue, BSP_CAN_NUM> tx_queue;
+static std::array<BusStat, BSP_CAN_NUM> bus_stat;
+static std::array<Can::Stat, BSP_CAN_NUM> stat_data;
+
 std::array<Message::Topic<Can::Pack>*, BSP_CAN_NUM> Can::can_tp_;
 
 std::array<System::Semaphore*, BSP_CAN_NUM> Can::can_sem_;
 
+std::array<Can::Dispatcher<Can::Pack>, BSP_CAN_NUM> Can::dispatcher_;
+
+std::array<Message::Topic<Can::Stat>*, BSP_CAN_NUM> Can::stat_tp_;
+
 static std::array<Can::Pack, BSP_CAN_NUM> pack;
 
-Can::Can() {
+static IdStat* id_stat_get(IdTable& table, uint32_t id) {
+  uint32_t i = (id * 0x9e3779b1u) >> (32 - DEVICE_CAN_STAT_ID_BITS);
+
+  while (table.slot[i].used.load(std::memory_order_acquire)) {
+    if (table.slot[i].id == id) {
+      return &table.slot[i];
+    }
+    i = (i + 1) & (DEV_CAN_ID_STAT_SIZE - 1);
+  }
+
+  if ((table.used + 1) * 4 > DEV_CAN_ID_STAT_SIZE * 3) {
+    return &table.other;
+  }
+
+  table.slot[i].id = id;
+  table.slot[i].used.store(true, std::memory_order_release);
+  table.used++;
+  return &table.slot[i];
+}
+
+/* 接收中断中调用，只做计数和抖动的整数运算 */
+static void rx_stat(bsp_can_t can, uint32_t id) {
+  BusStat& bus = bus_stat[can];
+
+  /* 回调中没有帧格式，按ID范围区分 */
+  bus.rx.frame++;
+  bus.rx.byte += sizeof(Can::Pack::data);
+  bus.rx.bit +=
+      id > 0x7ff ? DEV_CAN_EXT_FRAME_BITS : DEV_CAN_STD_FRAME_BITS;
+
+  IdStat* stat = id_stat_get(bus.rx_id, id);
+  uint32_t now = static_cast<uint32_t>(bsp_time_get_us());
+
+  if (stat->count > 0 && stat != &bus.rx_id.other) {
+    int32_t interval = static_cast<int32_t>(now - stat->last_time);
+
+    if (stat->count == 1) {
+      stat->period = interval * 16;
+    } else {
+      int32_t diff = interval - stat->interval;
+      if (diff < 0) {
+        diff = -diff;
+      }
+      stat->period += interval - stat->period / 16;
+      stat->jitter += diff - stat->jitter / 16;
+    }
+
+    stat->interval = interval;
+  }
+
+  stat->last_time = now;
+  stat->count++;
+}
+
+static uint32_t stat_rate(uint32_t count, uint32_t& last, uint32_t elapsed) {
+  uint32_t ans =
+      static_cast<uint32_t>(static_cast<uint64_t>(count - last) * 1000000 /
+                            elapsed);
+  last = count;
+  return ans;
+}
+
+static void stat_top_add(Can::Stat& stat, IdTable& table, bool tx) {
+  for (uint32_t i = 0; i < DEV_CAN_ID_STAT_SIZE; i++) {
+    IdStat& id_stat = table.slot[i];
+    if (!id_stat.used.load(std::memory_order_acquire)) {
+      continue;
+    }
+
+    /* top按速率从高到低排列 */
+    uint32_t pos = Can::STAT_TOP_NUM;
+    while (pos > 0 && stat.top[pos - 1].rate < id_stat.rate) {
+      pos--;
+    }
+    if (pos == Can::STAT_TOP_NUM) {
+      continue;
+    }
+
+    memmove(&stat.top[pos + 1], &stat.top[pos],
+            (Can::STAT_TOP_NUM - pos - 1) * sizeof(stat.top[0]));
+    stat.top[pos].id = id_stat.id;
+    stat.top[pos].tx = tx;
+    stat.top[pos].rate = id_stat.rate;
+  }
+}
+
+static void stat_update(bsp_can_t can, uint64_t now) {
+  BusStat& bus = bus_stat[can];
+  Can::Stat& stat = stat_data[can];
+  uint32_t elapsed = static_cast<uint32_t>(now - bus.last_time);
+  bus.last_time = now;
+
+  if (elapsed == 0) {
+    return;
+  }
+
+  stat.rx_frame = stat_rate(bus.rx.frame, bus.last_rx.frame, elapsed);
+  stat.tx_frame = stat_rate(bus.tx.frame, bus.last_tx.frame, elapsed);
+  stat.rx_byte = stat_rate(bus.rx.byte, bus.last_rx.byte, elapsed);
+  stat.tx_byte = stat_rate(bus.tx.byte, bus.last_tx.byte, elapsed);
+
+  uint32_t bit = stat_rate(bus.rx.bit, bus.last_rx.bit, elapsed) +
+                 stat_rate(bus.tx.bit, bus.last_tx.bit, elapsed);
+  stat.load = static_cast<float>(bit) * 100.0f /
+              static_cast<float>(DEVICE_CAN_BITRATE);
+
+  stat.tx_drop = bus.tx_id.other.drop;
+  stat.tx_timeout = bus.tx_id.other.timeout;
+  for (uint32_t i = 0; i < DEV_CAN_ID_STAT_SIZE; i++) {
+    IdStat& rx = bus.rx_id.slot[i];
+    IdStat& tx = bus.tx_id.slot[i];
+    if (rx.used.load(std::memory_order_acquire)) {
+      rx.rate = stat_rate(rx.count, rx.last_count, elapsed);
+    }
+    if (tx.used.load(std::memory_order_acquire)) {
+      tx.rate = stat_rate(tx.count, tx.last_count, elapsed);
+      stat.tx_drop += tx.drop;
+      stat.tx_timeout += tx.timeout;
+    }
+  }
+
+  stat.tx_error = bus.error;
+  stat.tx_queue = tx_queue[can].size;
+  stat.tx_queue_max = bus.queue_max;
+
+  memset(stat.top, 0, sizeof(stat.top));
+  stat_top_add(stat, bus.rx_id, false);
+  stat_top_add(stat, bus.tx_id, true);
+}
+
+Can::Can() : cmd_(this, ShowCMD, "can") {
   for (int i = 0; i < BSP_CAN_NUM; i++) {
     can_tp_[i] =
         new Message::Topic<Can::Pack>(("dev_can_" + std::to_string(i)).c_str());
+    stat_tp_[i] = new Message::Topic<Can::Stat>(
+        ("dev_can_stat_" + std::to_string(i)).c_str());
     can_sem_[i] = new System::Semaphore(true);
   }
 
@@ -21,48 +224,269 @@ Can::Can() {
     XB_UNUSED(arg);
 
     pack[can].index = id;
+    pack[can].time = bsp_can_get_rx_time(can);
 
     memcpy(pack[can].data, data, sizeof(pack[can].data));
 
+    rx_stat(can, id);
+
     can_tp_[can]->Publish(pack[can]);
+    dispatcher_[can].Publish(pack[can]);
+  };
+
+  auto tx_cplt_callback = [](bsp_can_t can, uint32_t id, uint8_t* data,
+                             void* arg) {
+    XB_UNUSED(id);
+    XB_UNUSED(data);
+    XB_UNUSED(arg);
+
+    TxDrain(can);
   };
 
   for (int i = 0; i < BSP_CAN_NUM; i++) {
+    for (int j = 0; j < DEVICE_CAN_TX_QUEUE_LEN; j++) {
+      tx_queue[i].order[j] = j;
+    }
+
     bsp_can_register_callback(static_cast<bsp_can_t>(i), CAN_RX_MSG_CALLBACK,
                               rx_callback, NULL);
+    bsp_can_register_callback(static_cast<bsp_can_t>(i), CAN_TX_CPLT_CALLBACK,
+                              tx_cplt_callback, NULL);
   }
 
   bsp_can_init();
+
+  auto stat_fn = [](Can* can) {
+    XB_UNUSED(can);
+
+    uint64_t now = bsp_time_get_us();
+    for (int i = 0; i < BSP_CAN_NUM; i++) {
+      stat_update(static_cast<bsp_can_t>(i), now);
+      stat_tp_[i]->Publish(stat_data[i]);
+    }
+  };
+
+  uint64_t now = bsp_time_get_us();
+  for (int i = 0; i < BSP_CAN_NUM; i++) {
+    bus_stat[i].last_time = now;
+  }
+
+  System::Timer::Create(stat_fn, this, DEV_CAN_STAT_CYCLE, "can_stat");
 }
 
-bool Can::SendPack(bsp_can_t can, bsp_can_format_t format, Pack& pack) {
-  can_sem_[can]->Wait(UINT32_MAX);
-  bool ans = bsp_can_trans_packet(can, format, pack.index, pack.data) == BSP_OK;
-  can_sem_[can]->Post();
-  return ans;
+/* 与总线仲裁一致：先比较11位基本ID，相同时标准帧优先 */
+static uint32_t tx_key(bsp_can_format_t format, uint32_t id) {
+  if (format == CAN_FORMAT_STD) {
+    return (id & 0x7ff) << 19;
+  } else {
+    return (((id >> 18) & 0x7ff) << 19) | (1u << 18) | (id & 0x3ffff);
+  }
 }
 
-bool Can::SendStdPack(bsp_can_t can, Pack& pack) {
-  can_sem_[can]->Wait(UINT32_MAX);
-  bool ans = bsp_can_trans_packet(can, CAN_FORMAT_STD, pack.index, pack.data) ==
-             BSP_OK;
-  can_sem_[can]->Post();
-  return ans;
+/* 需要持有发送锁，队列已满时丢弃优先级最低的帧 */
+static bool tx_push(bsp_can_t can, bsp_can_format_t format, Can::Pack& pack,
+                    uint32_t timeout) {
+  TxQueue& queue = tx_queue[can];
+  uint32_t key = tx_key(format, pack.index);
+
+  if (queue.size == DEVICE_CAN_TX_QUEUE_LEN) {
+    uint8_t lowest = queue.order[0];
+
+    if (key >= queue.frame[lowest].key) {
+      id_stat_get(bus_stat[can].tx_id, pack.index)->drop++;
+      return false;
+    }
+
+    id_stat_get(bus_stat[can].tx_id, queue.frame[lowest].pack.index)->drop++;
+    memmove(queue.order, queue.order + 1, queue.size - 1);
+    queue.order[--queue.size] = lowest;
+  }
+
+  uint8_t slot = queue.order[queue.size];
+  TxFrame& frame = queue.frame[slot];
+
+  frame.key = key;
+  frame.format = format;
+  frame.pack = pack;
+  frame.has_deadline = timeout != UINT32_MAX;
+  if (frame.has_deadline) {
+    frame.deadline = bsp_time_get_ms() + timeout;
+  }
+
+  /* 同优先级的帧按加入顺序发送 */
+  uint8_t pos = 0;
+  while (pos < queue.size && queue.frame[queue.order[pos]].key > key) {
+    pos++;
+  }
+
+  memmove(queue.order + pos + 1, queue.order + pos, queue.size - pos);
+  queue.order[pos] = slot;
+  queue.size++;
+
+  if (queue.size > bus_stat[can].queue_max) {
+    bus_stat[can].queue_max = queue.size;
+  }
+
+  return true;
+}
+
+uint32_t Can::TxFree(bsp_can_t can) {
+  return DEVICE_CAN_TX_QUEUE_LEN - tx_queue[can].size;
+}
+
+void Can::TxDrain(bsp_can_t can) {
+  TxQueue& queue = tx_queue[can];
+
+  while (queue.size > 0) {
+    TxFrame& frame = queue.frame[queue.order[queue.size - 1]];
+
+    if (frame.has_deadline &&
+        static_cast<int32_t>(bsp_time_get_ms() - frame.deadline) > 0) {
+      id_stat_get(bus_stat[can].tx_id, frame.pack.index)->timeout++;
+      queue.size--;
+      continue;
+    }
+
+    bsp_status_t ans = bsp_can_trans_packet_nowait(
+        can, frame.format, frame.pack.index, frame.pack.data);
+
+    /* 邮箱已满，等待发送完成中断 */
+    if (ans == BSP_ERR_FULL) {
+      break;
+    }
+
+    BusStat& bus = bus_stat[can];
+    if (ans == BSP_OK) {
+      bus.tx.frame++;
+      bus.tx.byte += sizeof(frame.pack.data);
+      bus.tx.bit += frame.format == CAN_FORMAT_STD ? DEV_CAN_STD_FRAME_BITS
+                                                   : DEV_CAN_EXT_FRAME_BITS;
+      id_stat_get(bus.tx_id, frame.pack.index)->count++;
+    } else {
+      bus.error++;
+    }
+
+    queue.size--;
+  }
 }
 
-bool Can::SendExtPack(bsp_can_t can, Pack& pack) {
+bool Can::SendPack(bsp_can_t can, bsp_can_format_t format, Pack& pack,
+                   uint32_t timeout) {
   can_sem_[can]->Wait(UINT32_MAX);
-  bool ans = bsp_can_trans_packet(can, CAN_FORMAT_EXT, pack.index, pack.data) ==
-             BSP_OK;
+  bsp_can_tx_lock(can);
+  bool ans = tx_push(can, format, pack, timeout);
+  TxDrain(can);
+  bsp_can_tx_unlock(can);
   can_sem_[can]->Post();
   return ans;
 }
 
+bool Can::SendStdPack(bsp_can_t can, Pack& pack, uint32_t timeout) {
+  return SendPack(can, CAN_FORMAT_STD, pack, timeout);
+}
+
+bool Can::SendExtPack(bsp_can_t can, Pack& pack, uint32_t timeout) {
+  return SendPack(can, CAN_FORMAT_EXT, pack, timeout);
+}
+
+/* 把标准帧ID范围拆分成若干个对齐的2的幂次块，每块对应一组硬件过滤器，
+ * 扩展帧由BSP全部放行，在软件中分发 */
+void Can::AddFilter(bsp_can_t can, uint32_t index, uint32_t num) {
+  const uint32_t STD_ID_NUM = 0x800;
+
+  if (index >= STD_ID_NUM) {
+    return;
+  }
+
+  uint32_t end = num > STD_ID_NUM - index ? STD_ID_NUM : index + num;
+
+  while (index < end) {
+    uint32_t size = index ? (index & (~index + 1)) : STD_ID_NUM;
+    while (index + size > end) {
+      size >>= 1;
+    }
+
+    bsp_can_add_filter(can, index, (STD_ID_NUM - 1) & ~(size - 1));
+    index += size;
+  }
+}
+
 bool Can::Subscribe(Message::Topic<Can::Pack>& tp, bsp_can_t can,
                     uint32_t index, uint32_t num) {
   ASSERT(num > 0);
 
-  can_tp_[can]->RangeDivide(tp, sizeof(Pack), offsetof(Pack, index),
-                            om_member_size_of(Pack, index), index, num);
+  dispatcher_[can].Add(tp, index, num);
+  AddFilter(can, index, num);
   return true;
 }
+
+static void stat_reset(IdTable& table) {
+  for (uint32_t i = 0; i < DEV_CAN_ID_STAT_SIZE; i++) {
+    table.slot[i].drop = 0;
+    table.slot[i].timeout = 0;
+    table.slot[i].jitter = 0;
+  }
+  table.other.drop = 0;
+  table.other.timeout = 0;
+}
+
+static void stat_show_id(IdTable& table, const char* dir) {
+  for (uint32_t i = 0; i < DEV_CAN_ID_STAT_SIZE; i++) {
+    IdStat& stat = table.slot[i];
+    if (!stat.used.load(std::memory_order_acquire)) {
+      continue;
+    }
+
+    printf("  0x%-8x %-4s %10u %10d %10d %8u %8u\r\n",
+           static_cast<unsigned int>(stat.id), dir,
+           static_cast<unsigned int>(stat.rate),
+           static_cast<int>(stat.period / 16),
+           static_cast<int>(stat.jitter / 16),
+           static_cast<unsigned int>(stat.drop),
+           static_cast<unsigned int>(stat.timeout));
+  }
+}
+
+int Can::ShowCMD(Can* can, int argc, char** argv) {
+  XB_UNUSED(can);
+
+  if (argc == 3 && strcmp(argv[1], "stat") == 0 &&
+      strcmp(argv[2], "reset") == 0) {
+    for (int i = 0; i < BSP_CAN_NUM; i++) {
+      stat_reset(bus_stat[i].rx_id);
+      stat_reset(bus_stat[i].tx_id);
+      bus_stat[i].error = 0;
+      bus_stat[i].queue_max = 0;
+    }
+    return 0;
+  }
+
+  if (argc != 2 || strcmp(argv[1], "stat") != 0) {
+    printf("stat 显示总线统计数据，每秒更新一次\r\n");
+    printf("stat reset 清空累计的丢包、错误和抖动数据\r\n");
+    return 0;
+  }
+
+  for (int i = 0; i < BSP_CAN_NUM; i++) {
+    Stat& stat = stat_data[i];
+
+    printf("can%d 占用率:%.1f%% 发送队列:%u/%u 丢弃:%u 超时:%u 错误:%u\r\n",
+           i, static_cast<double>(stat.load),
+           static_cast<unsigned int>(stat.tx_queue),
+           static_cast<unsigned int>(stat.tx_queue_max),
+           static_cast<unsigned int>(stat.tx_drop),
+           static_cast<unsigned int>(stat.tx_timeout),
+           static_cast<unsigned int>(stat.tx_error));
+    printf("  rx %u帧/s %uB/s tx %u帧/s %uB/s\r\n",
+           static_cast<unsigned int>(stat.rx_frame),
+           static_cast<unsigned int>(stat.rx_byte),
+           static_cast<unsigned int>(stat.tx_frame),
+           static_cast<unsigned int>(stat.tx_byte));
+    printf("  %-10s %-4s %10s %10s %10s %8s %8s\r\n", "id", "dir", "rate(/s)",
+           "period(us)", "jitter(us)", "drop", "timeout");
+    stat_show_id(bus_stat[i].rx_id, "rx");
+    stat_show_id(bus_stat[i].tx_id, "tx");
+  }
+
+  return 0;
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <device.hpp>
 
 #include "bsp_can.h"
@@ -10,20 +11,204 @@ class Can {
   typedef struct {
     uint32_t index;
     uint8_t data[8];
+    uint64_t time; /* 到达时间，与bsp_time_get_us()时基相同 单位：us */
   } Pack;
 
+  /* 统计数据中列出的速率最高的ID数量 */
+  static const uint32_t STAT_TOP_NUM = 5;
+
+  typedef struct {
+    uint32_t id;
+    bool tx;
+    uint32_t rate; /* 单位：帧/s */
+  } IdRate;
+
+  /* 总线统计数据，每秒更新一次 */
+  typedef struct {
+    uint32_t rx_frame; /* 单位：帧/s */
+    uint32_t tx_frame;
+    uint32_t rx_byte; /* 单位：字节/s */
+    uint32_t tx_byte;
+    float load;           /* 按不含位填充的帧长度估算的总线占用率 单位：% */
+    uint32_t tx_drop;     /* 累计因队列已满丢弃的帧数 */
+    uint32_t tx_timeout;  /* 累计超过有效期丢弃的帧数 */
+    uint32_t tx_error;    /* 累计发送失败的帧数 */
+    uint8_t tx_queue;     /* 发送队列当前长度 */
+    uint8_t tx_queue_max; /* 发送队列最大长度 */
+    IdRate top[STAT_TOP_NUM];
+  } Stat;
+
   Can();
 
-  static bool SendPack(bsp_can_t can, bsp_can_format_t format, Pack& pack);
+  /* 每条总线一张订阅表，在Subscribe时建立。订阅的ID较少时逐个放入
+   * 开放寻址的哈希表，收到数据包时按ID直接查找；ID范围较大的订阅
+   * (如转发整条总线的网关)放在单独的链表中。
+   * 中断中只读取订阅表，Subscribe先写好新节点再发布指针，扩容时
+   * 旧表可能仍在被读取，不释放。 */
+  template <typename PackType>
+  class Dispatcher {
+   public:
+    typedef struct Route {
+      uint32_t index;
+      uint32_t num;
+      Message::Topic<PackType> tp; /* 按值保存，订阅者传入的多为局部变量 */
+      struct Route* next;
+    } Route;
+
+    /* 超过这个数量的ID不再逐个放入哈希表 */
+    static const uint32_t EXACT_MAX = 16;
+
+    void Add(Message::Topic<PackType>& tp, uint32_t index, uint32_t num) {
+      if (num > EXACT_MAX) {
+        range_.store(NewRoute(tp, index, num, range_.load()),
+                     std::memory_order_release);
+        return;
+      }
+
+      for (uint32_t i = 0; i < num; i++) {
+        AddExact(tp, index + i);
+      }
+    }
+
+    void Publish(PackType& pack) {
+      Table* table = table_.load(std::memory_order_acquire);
+
+      if (table) {
+        for (uint32_t i = Hash(pack.index, table->shift);;
+             i = (i + 1) & table->mask) {
+          Route* route = table->slot[i].route.load(std::memory_order_acquire);
+          if (route == NULL) {
+            break;
+          }
+          if (table->slot[i].id == pack.index) {
+            for (; route; route = route->next) {
+              route->tp.Publish(pack);
+            }
+            break;
+          }
+        }
+      }
+
+      for (Route* route = range_.load(std::memory_order_acquire); route;
+           route = route->next) {
+        if (pack.index - route->index < route->num) {
+          route->tp.Publish(pack);
+        }
+      }
+    }
+
+   private:
+    typedef struct {
+      uint32_t id;
+      std::atomic<Route*> route; /* NULL表示空位 */
+    } Slot;
+
+    typedef struct {
+      uint32_t shift;
+      uint32_t mask;
+      uint32_t used;
+      Slot* slot;
+    } Table;
+
+    static uint32_t Hash(uint32_t id, uint32_t shift) {
+      return (id * 0x9e3779b1u) >> shift;
+    }
 
-  static bool SendStdPack(bsp_can_t can, Pack& pack);
+    static Route* NewRoute(Message::Topic<PackType>& tp, uint32_t index,
+                           uint32_t num, Route* next) {
+      return new Route{index, num, tp, next};
+    }
 
-  static bool SendExtPack(bsp_can_t can, Pack& pack);
+    static Table* NewTable(uint32_t bits) {
+      Table* table = new Table;
+      table->shift = 32 - bits;
+      table->mask = (1u << bits) - 1;
+      table->used = 0;
+      table->slot = new Slot[1u << bits];
+      for (uint32_t i = 0; i <= table->mask; i++) {
+        table->slot[i].id = 0;
+        table->slot[i].route.store(NULL, std::memory_order_relaxed);
+      }
+      return table;
+    }
+
+    static Slot* Find(Table* table, uint32_t id) {
+      uint32_t i = Hash(id, table->shift);
+      while (table->slot[i].route.load(std::memory_order_relaxed) != NULL &&
+             table->slot[i].id != id) {
+        i = (i + 1) & table->mask;
+      }
+      return &table->slot[i];
+    }
+
+    void AddExact(Message::Topic<PackType>& tp, uint32_t id) {
+      Table* table = table_.load(std::memory_order_relaxed);
+
+      /* 负载超过一半时扩容，复制到新表后再整体替换 */
+      if (table == NULL || (table->used + 1) * 2 > table->mask + 1) {
+        uint32_t bits = table ? 33 - table->shift : 4;
+        Table* new_table = NewTable(bits);
+        if (table) {
+          for (uint32_t i = 0; i <= table->mask; i++) {
+            Route* route =
+                table->slot[i].route.load(std::memory_order_relaxed);
+            if (route) {
+              Slot* slot = Find(new_table, table->slot[i].id);
+              slot->id = table->slot[i].id;
+              slot->route.store(route, std::memory_order_relaxed);
+              new_table->used++;
+            }
+          }
+        }
+        table_.store(new_table, std::memory_order_release);
+        table = new_table;
+      }
+
+      Slot* slot = Find(table, id);
+      Route* head = slot->route.load(std::memory_order_relaxed);
+      if (head == NULL) {
+        slot->id = id;
+        table->used++;
+      }
+      slot->route.store(NewRoute(tp, id, 1, head), std::memory_order_release);
+    }
+
+    std::atomic<Table*> table_{NULL};
+    std::atomic<Route*> range_{NULL};
+  };
+
+  /* 数据包按仲裁优先级放入总线的发送队列后立即返回，由发送完成中断
+   * 依次发出。timeout为有效期，单位ms，超时仍未发出的数据包被丢弃。
+   * 队列已满且优先级最低时返回false */
+  static bool SendPack(bsp_can_t can, bsp_can_format_t format, Pack& pack,
+                       uint32_t timeout = UINT32_MAX);
+
+  static bool SendStdPack(bsp_can_t can, Pack& pack,
+                          uint32_t timeout = UINT32_MAX);
+
+  static bool SendExtPack(bsp_can_t can, Pack& pack,
+                          uint32_t timeout = UINT32_MAX);
 
   static bool Subscribe(Message::Topic<Can::Pack>& tp, bsp_can_t can,
                         uint32_t index, uint32_t num);
 
+  /* 发出队列中的数据包，需要持有发送锁或在发送完成中断中调用 */
+  static void TxDrain(bsp_can_t can);
+
+  /* 发送队列的剩余空间，用于转发时的流量控制 */
+  static uint32_t TxFree(bsp_can_t can);
+
+  /* 为订阅的ID范围配置硬件过滤器 */
+  static void AddFilter(bsp_can_t can, uint32_t index, uint32_t num);
+
+  /* can stat：显示每条总线的收发速率、占用率、发送队列和各ID的统计 */
+  static int ShowCMD(Can* can, int argc, char** argv);
+
   static std::array<Message::Topic<Can::Pack>*, BSP_CAN_NUM> can_tp_;
   static std::array<System::Semaphore*, BSP_CAN_NUM> can_sem_;
+  static std::array<Dispatcher<Can::Pack>, BSP_CAN_NUM> dispatcher_;
+  static std::array<Message::Topic<Can::Stat>*, BSP_CAN_NUM> stat_tp_;
+
+  System::Term::Command<Can*> cmd_;
 };
 }  // namespace Device
@@ -53,7 +53,8 @@ class Cap {
 
   uint32_t last_online_time_ = 0;
 
-  System::Queue<Can::Pack> control_feedback_ = System::Queue<Can::Pack>(1);
+  System::Queue<Can::Pack, System::QUEUE_SPSC> control_feedback_ =
+      System::Queue<Can::Pack, System::QUEUE_SPSC>(1);
 
   System::Thread thread_;
 
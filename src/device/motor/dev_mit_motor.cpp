@@ -34,7 +34,7 @@ MitMotor::MitMotor(const Param &param, const char *name)
     : BaseMotor(name, param.reverse), param_(param) {
   auto rx_callback = [](Can::Pack &rx, MitMotor *motor) {
     if (rx.data[0] == motor->param_.id) {
-      motor->recv_.Overwrite(rx);
+      motor->recv_.Write(rx);
     }
 
     return true;
@@ -64,7 +64,7 @@ MitMotor::MitMotor(const Param &param, const char *name)
 bool MitMotor::Update() {
   Can::Pack pack;
 
-  while (this->recv_.Receive(pack)) {
+  if (this->recv_.Read(pack)) {
     this->Decode(pack);
     last_online_time_ = bsp_time_get_ms();
   }
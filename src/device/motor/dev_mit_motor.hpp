@@ -2,6 +2,7 @@
 
 #include <device.hpp>
 
+#include "comp_mailbox.hpp"
 #include "dev_can.hpp"
 #include "dev_motor.hpp"
 
@@ -41,7 +42,8 @@ class MitMotor : public BaseMotor {
 
   float current_ = 0.0f;
 
-  System::Queue<Can::Pack> recv_ = System::Queue<Can::Pack>(1);
+  /* 接收中断写入最新的反馈帧，Update()只解码新到的帧 */
+  Component::Mailbox<Can::Pack> recv_;
 
   static std::array<Message::Topic<Can::Pack> *, BSP_CAN_NUM> mit_tp_;
 };
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <device.hpp>
+
+#include "comp_mailbox.hpp"
+#include "dev_can.hpp"
+
+namespace Device {
+/* 一个模组中N个同型号电机，反馈和输出按结构数组存放。
+ * 每个电机一个最新帧邮箱，Update()一次读取所有新到的反馈帧，再在连续的
+ * 数组上统一换算；Control()一次写入所有输出，每条总线只获取一次锁。
+ * Motor需要提供Param(含can、id_feedback、reverse)、Unpack()、
+ * ANGLE_SCALE/SPEED_SCALE/CURRENT_SCALE、ControlBatch()和Register()，
+ * 目前只有RMMotor */
+template <typename Motor, size_t N>
+class MotorBank {
+ public:
+  typedef typename Motor::Param Param;
+
+  MotorBank(const std::array<Param, N>& param, const char* name)
+      : param_(param),
+        cmd_(this, MotorBank::ShowCMD, this->name_, System::Term::DevDir()) {
+    strncpy(this->name_, name, sizeof(this->name_) - 1);
+
+    auto rx_callback = [](Can::Pack& rx, Component::Mailbox<Can::Pack>* recv) {
+      recv->Write(rx);
+
+      return true;
+    };
+
+    for (size_t i = 0; i < N; i++) {
+      this->sign_[i] = param[i].reverse ? -1.0f : 1.0f;
+
+      Motor::Register(param[i]);
+
+      Message::Topic<Can::Pack> motor_tp(
+          (std::string(name) + "_" + std::to_string(i)).c_str());
+
+      motor_tp.RegisterCallback(rx_callback, &this->recv_[i]);
+
+      Can::Subscribe(motor_tp, param[i].can, param[i].id_feedback, 1);
+    }
+  }
+
+  void Update() {
+    Can::Pack pack;
+
+    for (size_t i = 0; i < N; i++) {
+      if (this->recv_[i].Read(pack)) {
+        Motor::Unpack(pack, this->raw_angle_[i], this->raw_speed_[i],
+                      this->raw_current_[i], this->raw_temp_[i]);
+        this->time_[i] = pack.time;
+      }
+    }
+
+    const float ANGLE_SCALE = Motor::ANGLE_SCALE;
+    const float SPEED_SCALE = Motor::SPEED_SCALE;
+    const float CURRENT_SCALE = Motor::CURRENT_SCALE;
+
+    /* 没有新反馈的电机按原值重新换算，循环中没有分支，可以向量化 */
+    for (size_t i = 0; i < N; i++) {
+      this->angle_[i] = static_cast<float>(this->raw_angle_[i]) * ANGLE_SCALE;
+      this->speed_[i] =
+          static_cast<float>(this->raw_speed_[i]) * SPEED_SCALE * this->sign_[i];
+      this->current_[i] = static_cast<float>(this->raw_current_[i]) *
+                          CURRENT_SCALE * this->sign_[i];
+      this->temp_[i] = static_cast<float>(this->raw_temp_[i]);
+    }
+  }
+
+  /* 输出范围-1到1，温度过高的电机不输出 */
+  void Control(const std::array<float, N>& output) {
+    bool over_temp = false;
+
+    for (size_t i = 0; i < N; i++) {
+      float out = output[i];
+      clampf(&out, -1.0f, 1.0f);
+
+      bool hot = this->temp_[i] > 75.0f;
+      over_temp |= hot;
+      this->output_[i] = hot ? 0.0f : out * this->sign_[i];
+    }
+
+    if (over_temp) {
+      OMLOG_WARNING("motor %s high temperature detected", this->name_);
+    }
+
+    Motor::ControlBatch(this->param_.data(), this->output_.data(), N);
+  }
+
+  void Relax() {
+    this->output_.fill(0.0f);
+
+    Motor::ControlBatch(this->param_.data(), this->output_.data(), N);
+  }
+
+  Component::Type::CycleValue GetAngle(size_t i) {
+    return this->sign_[i] * this->angle_[i];
+  }
+
+  float GetSpeed(size_t i) { return this->speed_[i]; }
+
+  float GetCurrent(size_t i) { return this->current_[i]; }
+
+  float GetTemp(size_t i) { return this->temp_[i]; }
+
+  /* 最近一次反馈的到达时间 单位：us */
+  uint64_t GetTime(size_t i) { return this->time_[i]; }
+
+  static int ShowCMD(MotorBank* bank, int argc, char** argv) {
+    XB_UNUSED(argv);
+
+    if (argc != 1) {
+      return 0;
+    }
+
+    printf("%4s %10s %10s %10s %8s %12s %8s %10s\r\n", "id", "角度(rad)",
+           "速度(rpm)", "电流(A)", "温度", "反馈时间(s)", "未更新", "被覆盖");
+
+    for (size_t i = 0; i < N; i++) {
+      printf("%4u %10.3f %10.1f %10.3f %8.1f %12.3f %8u %10u\r\n",
+             static_cast<unsigned int>(i), bank->GetAngle(i).Value(),
+             bank->speed_[i], bank->current_[i], bank->temp_[i],
+             static_cast<double>(bank->time_[i]) / 1000000.0,
+             static_cast<unsigned int>(bank->recv_[i].Stale()),
+             static_cast<unsigned int>(bank->recv_[i].Overwrite()));
+    }
+
+    return 0;
+  }
+
+ private:
+  std::array<Param, N> param_;
+
+  std::array<float, N> sign_{};
+
+  /* 反馈帧中的原始值 */
+  std::array<int32_t, N> raw_angle_{};
+  std::array<int32_t, N> raw_speed_{};
+  std::array<int32_t, N> raw_current_{};
+  std::array<int32_t, N> raw_temp_{};
+
+  /* 换算后的反馈，速度和电流已按安装方向取反 */
+  std::array<float, N> angle_{};
+  std::array<float, N> speed_{};
+  std::array<float, N> current_{};
+  std::array<float, N> temp_{};
+
+  std::array<uint64_t, N> time_{};
+
+  std::array<float, N> output_{};
+
+  /* 由接收中断写入，与上面的数组分开存放 */
+  std::array<Component::Mailbox<Can::Pack>, N> recv_;
+
+  char name_[25]{};
+
+  System::Term::Command<MotorBank*> cmd_;
+};
+}  // namespace Device
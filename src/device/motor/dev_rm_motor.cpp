@@ -17,11 +17,20 @@
 
 using namespace Device;
 
-uint8_t RMMotor::motor_tx_buff_[BSP_CAN_NUM][MOTOR_CTRL_ID_NUMBER][8];
+static const uint32_t MOTOR_CTRL_ID[MOTOR_CTRL_ID_NUMBER] = {
+    M3508_M2006_CTRL_ID_BASE, M3508_M2006_CTRL_ID_EXTAND,
+    GM6020_CTRL_ID_EXTAND};
 
-uint8_t RMMotor::motor_tx_flag_[BSP_CAN_NUM][MOTOR_CTRL_ID_NUMBER];
+const float RMMotor::ANGLE_SCALE = M_2PI / MOTOR_ENC_RES;
+const float RMMotor::SPEED_SCALE = 1.0f;
+const float RMMotor::CURRENT_SCALE =
+    static_cast<float>(M3508_MAX_ABS_CUR) / MOTOR_CUR_RES;
 
-uint8_t RMMotor::motor_tx_map_[BSP_CAN_NUM][MOTOR_CTRL_ID_NUMBER];
+RMMotor::Group RMMotor::group_[BSP_CAN_NUM][MOTOR_CTRL_ID_NUMBER];
+
+std::array<System::Semaphore*, BSP_CAN_NUM> RMMotor::group_sem_;
+
+std::array<System::Timer::TimerHandle, BSP_CAN_NUM> RMMotor::flush_timer_;
 
 RMMotor::RMMotor(const Param &param, const char *name)
     : BaseMotor(name, param.reverse), param_(param) {
@@ -29,17 +38,75 @@ RMMotor::RMMotor(const Param &param, const char *name)
 
   memset(&(this->feedback_), 0, sizeof(this->feedback_));
 
+  Locate(param, this->index_, this->num_);
+
+  auto rx_callback = [](Can::Pack &rx, RMMotor *motor) {
+    motor->recv_.Write(rx);
+
+    motor->last_online_time_ = bsp_time_get_ms();
+
+    return true;
+  };
+
+  Message::Topic<Can::Pack> motor_tp(name);
+
+  motor_tp.RegisterCallback(rx_callback, this);
+
+  Can::Subscribe(motor_tp, this->param_.can, this->param_.id_feedback, 1);
+
+  Register(this->param_);
+}
+
+void RMMotor::Init() {
+  if (group_sem_[0] != NULL) {
+    return;
+  }
+
+  for (int i = 0; i < BSP_CAN_NUM; i++) {
+    group_sem_[i] = new System::Semaphore(true);
+  }
+
+  auto flush_fn = [](bsp_can_t can) { Flush(can); };
+
+  for (int i = 0; i < BSP_CAN_NUM; i++) {
+    flush_timer_[i] = System::Timer::CreateMicroseconds(
+        flush_fn, static_cast<bsp_can_t>(i), DEVICE_RM_MOTOR_FLUSH_TIMEOUT,
+        System::Timer::ONE_SHOT, "rm_motor");
+  }
+
+  new System::Term::Command<void*>(NULL, FlushCMD, "rm_motor");
+}
+
+void RMMotor::Register(const Param& param) {
+  Init();
+
+  if (GetLSB(param.model) == 0.0f) {
+    return;
+  }
+
+  uint8_t index = 0, num = 0;
+  Locate(param, index, num);
+
+  group_sem_[param.can]->Wait(UINT32_MAX);
+  group_[param.can][index].mask |= static_cast<uint8_t>(1u << num);
+  group_sem_[param.can]->Post();
+}
+
+void RMMotor::Locate(const Param &param, uint8_t &index, uint8_t &num) {
+  index = 0;
+  num = 0;
+
   switch (param.id_control) {
     case M3508_M2006_CTRL_ID_BASE:
-      this->index_ = 0;
+      index = 0;
       ASSERT(param.id_feedback > 0x200 && param.id_feedback <= 0x204);
       break;
     case M3508_M2006_CTRL_ID_EXTAND:
-      this->index_ = 1;
+      index = 1;
       ASSERT(param.id_feedback > 0x204 && param.id_feedback <= 0x208);
       break;
     case GM6020_CTRL_ID_EXTAND:
-      this->index_ = 2;
+      index = 2;
       ASSERT(param.id_feedback > 0x208 && param.id_feedback <= 0x20B);
       break;
     default:
@@ -49,67 +116,59 @@ RMMotor::RMMotor(const Param &param, const char *name)
     case MOTOR_M2006:
     case MOTOR_M3508:
       if (param.id_control == M3508_M2006_CTRL_ID_BASE) {
-        this->num_ = param.id_feedback - M3508_M2006_FB_ID_BASE;
+        num = param.id_feedback - M3508_M2006_FB_ID_BASE;
       } else {
-        this->num_ = param.id_feedback - M3508_M2006_FB_ID_EXTAND;
+        num = param.id_feedback - M3508_M2006_FB_ID_EXTAND;
       }
       break;
     case MOTOR_GM6020:
       if (param.id_control == GM6020_CTRL_ID_BASE) {
-        this->num_ = param.id_feedback - GM6020_FB_ID_BASE;
+        num = param.id_feedback - GM6020_FB_ID_BASE;
       } else {
-        this->num_ = param.id_feedback - GM6020_FB_ID_EXTAND;
+        num = param.id_feedback - GM6020_FB_ID_EXTAND;
       }
       break;
     default:
       break;
   }
-
-  auto rx_callback = [](Can::Pack &rx, RMMotor *motor) {
-    motor->recv_.Overwrite(rx);
-
-    motor->last_online_time_ = bsp_time_get_ms();
-
-    return true;
-  };
-
-  Message::Topic<Can::Pack> motor_tp(name);
-
-  motor_tp.RegisterCallback(rx_callback, this);
-
-  Can::Subscribe(motor_tp, this->param_.can, this->param_.id_feedback, 1);
-
-  motor_tx_map_[this->param_.can][this->index_] |= 1 << (this->num_);
 }
 
 bool RMMotor::Update() {
   Can::Pack pack;
 
-  while (this->recv_.Receive(pack)) {
-    if ((pack.index == this->param_.id_feedback) &&
-        (MOTOR_NONE != this->param_.model)) {
-      this->Decode(pack);
-    }
+  if (this->recv_.Read(pack) && (pack.index == this->param_.id_feedback) &&
+      (MOTOR_NONE != this->param_.model)) {
+    this->Decode(pack);
   }
 
   return true;
 }
 
+void RMMotor::Unpack(const Can::Pack &rx, int32_t &angle, int32_t &speed,
+                     int32_t &current, int32_t &temp) {
+  angle = static_cast<uint16_t>((rx.data[0] << 8) | rx.data[1]);
+  speed = static_cast<int16_t>((rx.data[2] << 8) | rx.data[3]);
+  current = static_cast<int16_t>((rx.data[4] << 8) | rx.data[5]);
+  temp = rx.data[6];
+}
+
 void RMMotor::Decode(Can::Pack &rx) {
-  uint16_t raw_angle = static_cast<uint16_t>((rx.data[0] << 8) | rx.data[1]);
-  int16_t raw_current = static_cast<int16_t>((rx.data[4] << 8) | rx.data[5]);
+  int32_t raw_angle = 0, raw_speed = 0, raw_current = 0, raw_temp = 0;
+
+  Unpack(rx, raw_angle, raw_speed, raw_current, raw_temp);
 
   this->feedback_.rotor_abs_angle =
-      static_cast<float>(raw_angle) / MOTOR_ENC_RES * M_2PI;
-  this->feedback_.rotational_speed =
-      static_cast<int16_t>((rx.data[2] << 8) | rx.data[3]);
+      static_cast<float>(raw_angle) * ANGLE_SCALE;
+  this->feedback_.rotational_speed = static_cast<float>(raw_speed);
   this->feedback_.torque_current =
-      static_cast<float>(raw_current) * M3508_MAX_ABS_CUR / MOTOR_CUR_RES;
-  this->feedback_.temp = rx.data[6];
+      static_cast<float>(raw_current) * CURRENT_SCALE;
+  this->feedback_.temp = static_cast<float>(raw_temp);
 }
 
-float RMMotor::GetLSB() {
-  switch (this->param_.model) {
+float RMMotor::GetLSB() { return GetLSB(this->param_.model); }
+
+float RMMotor::GetLSB(Model model) {
+  switch (model) {
     case MOTOR_M2006:
       return M2006_MAX_ABS_LSB;
 
@@ -124,6 +183,53 @@ float RMMotor::GetLSB() {
   }
 }
 
+/* 需要持有group_sem_，返回是否为本次发送前的第一次写入 */
+static bool group_write(RMMotor::Group &group, uint8_t num, int16_t cmd) {
+  bool first = !group.dirty;
+
+  if (first) {
+    group.dirty = true;
+    group.write_time = bsp_time_get_us();
+  }
+  group.written |= static_cast<uint8_t>(1u << num);
+  group.data[2 * num] = static_cast<uint8_t>((cmd >> 8) & 0xFF);
+  group.data[2 * num + 1] = static_cast<uint8_t>(cmd & 0xFF);
+
+  return first;
+}
+
+/* 需要持有group_sem_，返回是否有需要发出的数据 */
+static bool group_take(RMMotor::Group& group, Can::Pack& pack, uint32_t id) {
+  if (!group.dirty) {
+    return false;
+  }
+
+  uint32_t latency =
+      static_cast<uint32_t>(bsp_time_get_us() - group.write_time);
+  if (latency > group.max_latency) {
+    group.max_latency = latency;
+  }
+  group.sum_latency += latency;
+  group.count++;
+  group.dirty = false;
+  group.written = 0;
+
+  pack.index = id;
+  memcpy(pack.data, group.data, sizeof(pack.data));
+
+  return true;
+}
+
+/* 需要持有group_sem_，所有注册的电机都已写入时取出控制帧 */
+static bool group_take_complete(RMMotor::Group& group, Can::Pack& pack,
+                                uint32_t id) {
+  if (!group.dirty || (group.written & group.mask) != group.mask) {
+    return false;
+  }
+
+  return group_take(group, pack, id);
+}
+
 void RMMotor::Control(float out) {
   if (this->feedback_.temp > 75.0f) {
     out = 0.0f;
@@ -136,38 +242,144 @@ void RMMotor::Control(float out) {
   } else {
     this->output_ = out;
   }
-  float lsb = this->GetLSB();
 
-  if (lsb != 0.0f) {
-    int16_t ctrl_cmd = static_cast<int16_t>(this->output_ * lsb);
-    motor_tx_buff_[this->param_.can][this->index_][2 * this->num_] =
-        static_cast<uint8_t>((ctrl_cmd >> 8) & 0xFF);
-    motor_tx_buff_[this->param_.can][this->index_][2 * this->num_ + 1] =
-        static_cast<uint8_t>(ctrl_cmd & 0xFF);
-    motor_tx_flag_[this->param_.can][this->index_] |= 1 << (this->num_);
+  ControlBatch(&this->param_, &this->output_, 1);
+}
+
+void RMMotor::ControlBatch(const Param *param, const float *output,
+                           size_t len) {
+  for (int can = 0; can < BSP_CAN_NUM; can++) {
+    bool locked = false, first = false;
+    Can::Pack pack[MOTOR_CTRL_ID_NUMBER];
+    bool complete[MOTOR_CTRL_ID_NUMBER] = {};
+
+    for (size_t i = 0; i < len; i++) {
+      float lsb = GetLSB(param[i].model);
+      if (param[i].can != can || lsb == 0.0f) {
+        continue;
+      }
+
+      uint8_t index = 0, num = 0;
+      Locate(param[i], index, num);
+
+      if (!locked) {
+        group_sem_[can]->Wait(UINT32_MAX);
+        locked = true;
+      }
+
+      first |= group_write(group_[can][index], num,
+                           static_cast<int16_t>(output[i] * lsb));
+    }
+
+    if (!locked) {
+      continue;
+    }
 
-    if (((~motor_tx_flag_[this->param_.can][this->index_]) &
-         (motor_tx_map_[this->param_.can][this->index_])) == 0) {
-      this->SendData();
+    bool pending = false, sent = false;
+    for (int i = 0; i < MOTOR_CTRL_ID_NUMBER; i++) {
+      complete[i] =
+          group_take_complete(group_[can][i], pack[i], MOTOR_CTRL_ID[i]);
+      sent |= complete[i];
+      pending |= group_[can][i].dirty;
+    }
+    group_sem_[can]->Post();
+
+    for (int i = 0; i < MOTOR_CTRL_ID_NUMBER; i++) {
+      if (complete[i]) {
+        Can::SendStdPack(static_cast<bsp_can_t>(can), pack[i]);
+      }
+    }
+
+    /* 超时从第一次写入开始计算，帧已全部发出时停止，
+     * 下一次写入时重新计时 */
+    if (pending && first) {
+      System::Timer::Start(flush_timer_[can]);
+    } else if (!pending && sent) {
+      System::Timer::Stop(flush_timer_[can]);
     }
   }
 }
 
-bool RMMotor::SendData() {
-  Can::Pack tx_buff;
+void RMMotor::SendGroup(bsp_can_t can, uint8_t index) {
+  Can::Pack pack;
+
+  group_sem_[can]->Wait(UINT32_MAX);
+  bool ans = group_take(group_[can][index], pack, MOTOR_CTRL_ID[index]);
+  group_sem_[can]->Post();
+
+  if (ans) {
+    Can::SendStdPack(can, pack);
+  }
+}
 
-  tx_buff.index = this->param_.id_control;
+void RMMotor::Flush(bsp_can_t can) {
+  Can::Pack pack[MOTOR_CTRL_ID_NUMBER];
+  bool ans[MOTOR_CTRL_ID_NUMBER];
 
-  memcpy(tx_buff.data, motor_tx_buff_[this->param_.can][this->index_],
-         sizeof(tx_buff.data));
+  /* 先取出所有控制帧再发送，发送时不阻塞Control() */
+  group_sem_[can]->Wait(UINT32_MAX);
+  for (int i = 0; i < MOTOR_CTRL_ID_NUMBER; i++) {
+    ans[i] = group_take(group_[can][i], pack[i], MOTOR_CTRL_ID[i]);
+  }
+  group_sem_[can]->Post();
 
-  Can::SendStdPack(this->param_.can, tx_buff);
+  for (int i = 0; i < MOTOR_CTRL_ID_NUMBER; i++) {
+    if (ans[i]) {
+      Can::SendStdPack(can, pack[i]);
+    }
+  }
+}
 
-  motor_tx_flag_[this->param_.can][this->index_] = 0;
+bool RMMotor::SendData() {
+  SendGroup(this->param_.can, this->index_);
 
   return true;
 }
 
+int RMMotor::FlushCMD(void* arg, int argc, char** argv) {
+  XB_UNUSED(arg);
+
+  if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+    for (int i = 0; i < BSP_CAN_NUM; i++) {
+      group_sem_[i]->Wait(UINT32_MAX);
+      for (int j = 0; j < MOTOR_CTRL_ID_NUMBER; j++) {
+        group_[i][j].count = 0;
+        group_[i][j].max_latency = 0;
+        group_[i][j].sum_latency = 0;
+      }
+      group_sem_[i]->Post();
+    }
+    return 0;
+  }
+
+  if (argc != 1) {
+    printf("[reset] 清空统计数据\r\n");
+    return 0;
+  }
+
+  printf("未写全时的发送超时:%uus\r\n",
+         static_cast<unsigned int>(DEVICE_RM_MOTOR_FLUSH_TIMEOUT));
+  printf("%-6s %-8s %10s %16s %16s\r\n", "can", "id", "count",
+         "avg latency(us)", "max latency(us)");
+
+  for (int i = 0; i < BSP_CAN_NUM; i++) {
+    for (int j = 0; j < MOTOR_CTRL_ID_NUMBER; j++) {
+      Group& group = group_[i][j];
+      if (group.count == 0) {
+        continue;
+      }
+
+      printf("%-6d 0x%-6x %10u %16u %16u\r\n", i,
+             static_cast<unsigned int>(MOTOR_CTRL_ID[j]),
+             static_cast<unsigned int>(group.count),
+             static_cast<unsigned int>(group.sum_latency / group.count),
+             static_cast<unsigned int>(group.max_latency));
+    }
+  }
+
+  return 0;
+}
+
 void RMMotor::Offline() {
   memset(&(this->feedback_), 0, sizeof(this->feedback_));
 }
@@ -3,6 +3,7 @@
 #include <device.hpp>
 
 #include "bsp_can.h"
+#include "comp_mailbox.hpp"
 #include "dev_can.hpp"
 #include "dev_motor.hpp"
 
@@ -44,6 +45,21 @@ class RMMotor : public BaseMotor {
     bool reverse;
   } Param;
 
+  /* 同一控制ID下最多4个电机共用一个控制帧，Control()写入缓冲。
+   * 注册到该帧的电机都写入后由最后一个写入者立即发出；有电机未写入时，
+   * 由第一次写入启动的单次定时器在DEVICE_RM_MOTOR_FLUSH_TIMEOUT us后发出，
+   * 不会因某个电机未受控而一直不发送 */
+  typedef struct {
+    uint8_t data[8];
+    uint8_t mask;    /* 注册到该帧的电机 */
+    uint8_t written; /* 本次发送前已写入的电机 */
+    bool dirty;
+    uint64_t write_time;  /* 本周期第一次写入的时间 单位：us */
+    uint32_t count;       /* 发出的帧数 */
+    uint32_t max_latency; /* 写入到发出的最大延迟 单位：us */
+    uint64_t sum_latency;
+  } Group;
+
   RMMotor(const Param& param, const char* name);
 
   RMMotor(RMMotor& motor);
@@ -52,6 +68,7 @@ class RMMotor : public BaseMotor {
 
   bool Update();
 
+  /* 立即发出该电机所在的控制帧 */
   bool SendData();
 
   void Control(float output);
@@ -62,6 +79,34 @@ class RMMotor : public BaseMotor {
 
   void Relax();
 
+  /* 发出该总线上本周期内写入过的控制帧 */
+  static void Flush(bsp_can_t can);
+
+  static int FlushCMD(void* arg, int argc, char** argv);
+
+  /* 以下供MotorBank批量处理，反馈换算为 原始值 * SCALE */
+  static const float ANGLE_SCALE;
+  static const float SPEED_SCALE;
+  static const float CURRENT_SCALE;
+
+  static void Unpack(const Can::Pack& rx, int32_t& angle, int32_t& speed,
+                     int32_t& current, int32_t& temp);
+
+  /* 控制帧的序号和电机在帧中的位置 */
+  static void Locate(const Param& param, uint8_t& index, uint8_t& num);
+
+  static float GetLSB(Model model);
+
+  /* 写入多个电机的输出，范围-1到1，每条总线只获取一次锁 */
+  static void ControlBatch(const Param* param, const float* output,
+                           size_t len);
+
+  /* 创建各总线的发送定时器 */
+  static void Init();
+
+  /* 把电机登记到所在的控制帧，电机或MotorBank构造时调用 */
+  static void Register(const Param& param);
+
  private:
   Param param_;
 
@@ -71,12 +116,16 @@ class RMMotor : public BaseMotor {
 
   float output_;
 
-  static uint8_t motor_tx_buff_[BSP_CAN_NUM][MOTOR_CTRL_ID_NUMBER][8];
+  static void SendGroup(bsp_can_t can, uint8_t index);
+
+  static Group group_[BSP_CAN_NUM][MOTOR_CTRL_ID_NUMBER];
 
-  static uint8_t motor_tx_flag_[BSP_CAN_NUM][MOTOR_CTRL_ID_NUMBER];
+  static std::array<System::Semaphore*, BSP_CAN_NUM> group_sem_;
 
-  static uint8_t motor_tx_map_[BSP_CAN_NUM][MOTOR_CTRL_ID_NUMBER];
+  /* 控制帧写入不完整时的发送超时，每条总线一个单次定时器 */
+  static std::array<System::Timer::TimerHandle, BSP_CAN_NUM> flush_timer_;
 
-  System::Queue<Can::Pack> recv_ = System::Queue<Can::Pack>(1);
+  /* 接收中断写入最新的反馈帧，Update()只解码新到的帧 */
+  Component::Mailbox<Can::Pack> recv_;
 };
 }  // namespace Device
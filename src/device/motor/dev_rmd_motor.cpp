@@ -23,7 +23,7 @@ RMDMotor::RMDMotor(const Param &param, const char *name)
   memset(&(this->feedback_), 0, sizeof(this->feedback_));
 
   auto rx_callback = [](Can::Pack &rx, RMDMotor *motor) {
-    motor->recv_.Overwrite(rx);
+    motor->recv_.Write(rx);
 
     motor->last_online_time_ = bsp_time_get_ms();
 
@@ -42,7 +42,7 @@ RMDMotor::RMDMotor(const Param &param, const char *name)
 bool RMDMotor::Update() {
   Can::Pack pack;
 
-  while (this->recv_.Receive(pack)) {
+  if (this->recv_.Read(pack)) {
     this->Decode(pack);
   }
 
@@ -3,6 +3,7 @@
 #include <device.hpp>
 
 #include "bsp_can.h"
+#include "comp_mailbox.hpp"
 #include "dev_can.hpp"
 #include "dev_motor.hpp"
 
@@ -42,6 +43,7 @@ class RMDMotor : public BaseMotor {
 
   static uint8_t motor_tx_map_[BSP_CAN_NUM];
 
-  System::Queue<Can::Pack> recv_ = System::Queue<Can::Pack>(1);
+  /* 接收中断写入最新的反馈帧，Update()只解码新到的帧 */
+  Component::Mailbox<Can::Pack> recv_;
 };
 }  // namespace Device
@@ -497,23 +497,23 @@ class Referee {
 
   Message::Topic<Data> ref_data_tp_ = Message::Topic<Data>("referee");
 
-  System::Queue<Component::UI::Ele> ele_data_ =
-      System::Queue<Component::UI::Ele>(10);
+  System::Queue<Component::UI::Ele, System::QUEUE_MPSC> ele_data_ =
+      System::Queue<Component::UI::Ele, System::QUEUE_MPSC>(10);
 
-  System::Queue<Component::UI::Str> string_data_ =
-      System::Queue<Component::UI::Str>(10);
+  System::Queue<Component::UI::Str, System::QUEUE_MPSC> string_data_ =
+      System::Queue<Component::UI::Str, System::QUEUE_MPSC>(10);
 
-  System::Queue<Component::UI::Del> del_data_ =
-      System::Queue<Component::UI::Del>(10);
+  System::Queue<Component::UI::Del, System::QUEUE_MPSC> del_data_ =
+      System::Queue<Component::UI::Del, System::QUEUE_MPSC>(10);
 
-  System::Queue<Component::UI::Ele> static_ele_data_ =
-      System::Queue<Component::UI::Ele>(10);
+  System::Queue<Component::UI::Ele, System::QUEUE_MPSC> static_ele_data_ =
+      System::Queue<Component::UI::Ele, System::QUEUE_MPSC>(10);
 
-  System::Queue<Component::UI::Str> static_string_data_ =
-      System::Queue<Component::UI::Str>(10);
+  System::Queue<Component::UI::Str, System::QUEUE_MPSC> static_string_data_ =
+      System::Queue<Component::UI::Str, System::QUEUE_MPSC>(10);
 
-  System::Queue<Component::UI::Del> static_del_data_ =
-      System::Queue<Component::UI::Del>(10);
+  System::Queue<Component::UI::Del, System::QUEUE_MPSC> static_del_data_ =
+      System::Queue<Component::UI::Del, System::QUEUE_MPSC>(10);
 
   System::Semaphore ui_lock_ = System::Semaphore(true);
 
@@ -1,14 +1,22 @@
 #include "can_usart.hpp"
 
 #include "bsp_can.h"
+#include "bsp_time.h"
 #include "bsp_uart.h"
 
 using namespace Module;
 
+static uint32_t ring_next(uint32_t pos) {
+  return pos + 1 >= MODULE_CAN_USART_TX_RING_LEN ? 0 : pos + 1;
+}
+
 CantoUsart::CantoUsart()
     : uart_recv_buff_addr_(&uart_recv_buff_1_),
-      tx_cplt_(true),
-      tx_ready_(false) {
+      tx_head_(0),
+      tx_tail_(0),
+      tx_busy_(false),
+      reset_time_(bsp_time_get_ms()),
+      cmd_(this, ShowCMD, "can_usart") {
   auto rx_callback_fn = [](void *arg) {
     CantoUsart *can_uart = static_cast<CantoUsart *>(arg);
 
@@ -49,22 +57,60 @@ CantoUsart::CantoUsart()
   bsp_uart_receive(BSP_UART_MCU, &uart_recv_buff_1_[0],
                    sizeof(uart_recv_buff_1_), false);
 
+  /* 串口发送完成中断的优先级高于CAN接收中断，不会被生产者打断，
+   * 期间新写入的帧在这里接着发出 */
   auto tx_cplt_cb = [](void *arg) {
     CantoUsart *can_uart = static_cast<CantoUsart *>(arg);
 
-    can_uart->tx_cplt_.Post();
+    uint32_t tail = can_uart->tx_tail_.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < can_uart->tx_sending_; i++) {
+      tail = ring_next(tail);
+    }
+    can_uart->tx_tail_.store(tail, std::memory_order_release);
+    can_uart->tx_sending_ = 0;
+
+    if (!can_uart->TxStart()) {
+      can_uart->tx_busy_ = false;
+    }
   };
 
   bsp_uart_register_callback(BSP_UART_MCU, BSP_UART_TX_CPLT_CB, tx_cplt_cb,
                              this);
 
   auto rx_callback = [](Device::Can::Pack &rx, CantoUsart *can_uart) {
-    can_uart->uart_trans_buff_.start_frame = START;
-    can_uart->uart_trans_buff_.id = rx.index;
-    can_uart->uart_trans_buff_.type = CAN_FORMAT_STD;
-    memcpy(&can_uart->uart_trans_buff_.data, rx.data, sizeof(rx.data));
-    can_uart->uart_trans_buff_.end_frame = END;
-    can_uart->tx_ready_.Post();
+    uint32_t head = can_uart->tx_head_.load(std::memory_order_relaxed);
+    uint32_t tail = can_uart->tx_tail_.load(std::memory_order_acquire);
+    uint32_t next = ring_next(head);
+
+    if (next == tail) {
+      can_uart->drop_count_++;
+      return true;
+    }
+
+    UartData &data = can_uart->tx_ring_[head];
+    data.start_frame = START;
+    data.id = rx.index;
+    data.type = CAN_FORMAT_STD;
+    memcpy(&data.data, rx.data, sizeof(rx.data));
+    data.end_frame = END;
+
+    can_uart->tx_head_.store(next, std::memory_order_release);
+    can_uart->frame_count_++;
+
+    uint32_t used = next >= tail ? next - tail
+                                 : next + MODULE_CAN_USART_TX_RING_LEN - tail;
+    if (used > can_uart->ring_max_) {
+      can_uart->ring_max_ = used;
+    }
+
+    /* 串口空闲时没有发送完成中断，由生产者启动发送 */
+    if (!can_uart->tx_busy_) {
+      can_uart->tx_busy_ = true;
+      if (!can_uart->TxStart()) {
+        can_uart->tx_busy_ = false;
+      }
+    }
+
     return true;
   };
 
@@ -72,17 +118,62 @@ CantoUsart::CantoUsart()
   cap_tp.RegisterCallback(rx_callback, this);
 
   Device::Can::Subscribe(cap_tp, BSP_CAN_1, 0, UINT32_MAX);
+}
 
-  auto uart_send_fn = [](CantoUsart *can_uart) {
-    while (1) {
-      can_uart->tx_ready_.Wait(UINT32_MAX);
-      can_uart->tx_cplt_.Wait(UINT32_MAX);
-      bsp_uart_transmit(
-          BSP_UART_MCU,
-          reinterpret_cast<uint8_t *>(&can_uart->uart_trans_buff_),
-          sizeof(UartData), false);
-    }
-  };
+bool CantoUsart::TxStart() {
+  uint32_t head = tx_head_.load(std::memory_order_acquire);
+  uint32_t tail = tx_tail_.load(std::memory_order_relaxed);
+
+  if (head == tail) {
+    return false;
+  }
+
+  /* 环回绕处分两次发送 */
+  uint32_t num = head > tail ? head - tail : MODULE_CAN_USART_TX_RING_LEN - tail;
+
+  if (bsp_uart_transmit(BSP_UART_MCU,
+                        reinterpret_cast<uint8_t *>(&tx_ring_[tail]),
+                        num * sizeof(UartData), false) != BSP_OK) {
+    return false;
+  }
+
+  tx_sending_ = num;
+  burst_count_++;
+  return true;
+}
 
-  System::Timer::Create(uart_send_fn, this, 0);
+int CantoUsart::ShowCMD(CantoUsart *can_uart, int argc, char **argv) {
+  if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+    can_uart->frame_count_ = 0;
+    can_uart->drop_count_ = 0;
+    can_uart->burst_count_ = 0;
+    can_uart->ring_max_ = 0;
+    can_uart->reset_time_ = bsp_time_get_ms();
+    return 0;
+  }
+
+  if (argc != 1) {
+    printf("[reset] 清空统计数据\r\n");
+    return 0;
+  }
+
+  uint32_t time = bsp_time_get_ms() - can_uart->reset_time_;
+
+  printf("%10s %10s %10s %12s %14s %10s\r\n", "frame", "drop", "burst",
+         "frame/burst", "ring max", "frame/s");
+  printf("%10u %10u %10u %12u %9u/%-4u %10u\r\n",
+         static_cast<unsigned int>(can_uart->frame_count_),
+         static_cast<unsigned int>(can_uart->drop_count_),
+         static_cast<unsigned int>(can_uart->burst_count_),
+         static_cast<unsigned int>(
+             can_uart->burst_count_
+                 ? can_uart->frame_count_ / can_uart->burst_count_
+                 : 0),
+         static_cast<unsigned int>(can_uart->ring_max_),
+         static_cast<unsigned int>(MODULE_CAN_USART_TX_RING_LEN - 1),
+         static_cast<unsigned int>(
+             time ? static_cast<uint64_t>(can_uart->frame_count_) * 1000 / time
+                  : 0));
+
+  return 0;
 }
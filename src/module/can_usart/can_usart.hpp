@@ -1,3 +1,5 @@
+#include <atomic>
+
 #include "dev_can.hpp"
 #include "module.hpp"
 
@@ -16,12 +18,30 @@ class CantoUsart {
 
   CantoUsart();
 
+  static int ShowCMD(CantoUsart* can_uart, int argc, char** argv);
+
  private:
+  /* 从发送环中取出连续的一段启动DMA发送，只由持有tx_busy_的一方调用 */
+  bool TxStart();
+
   std::array<uint8_t, sizeof(UartData) * 2> uart_recv_buff_1_;
   std::array<uint8_t, sizeof(UartData) * 2> uart_recv_buff_2_;
   std::array<uint8_t, sizeof(UartData) * 2>* uart_recv_buff_addr_;
-  UartData uart_trans_buff_;
-  System::Semaphore tx_cplt_;
-  System::Semaphore tx_ready_;
+
+  /* CAN接收中断写入head，串口发送完成后推进tail，
+   * DMA直接从环中发送，发送中的帧在完成前不会被覆盖 */
+  std::array<UartData, MODULE_CAN_USART_TX_RING_LEN> tx_ring_;
+  std::atomic<uint32_t> tx_head_;
+  std::atomic<uint32_t> tx_tail_;
+  uint32_t tx_sending_ = 0;
+  std::atomic<bool> tx_busy_;
+
+  uint32_t frame_count_ = 0;
+  uint32_t drop_count_ = 0;
+  uint32_t burst_count_ = 0;
+  uint32_t ring_max_ = 0;
+  uint32_t reset_time_ = 0;
+
+  System::Term::Command<CantoUsart*> cmd_;
 };
 }  // namespace Module
@@ -3,3 +3,524 @@
 using namespace Module;
 
 FDCanToUart* FDCanToUart::self_;
+
+static uint32_t ring_used(uint32_t head, uint32_t tail) {
+  return head >= tail ? head - tail
+                      : head + MODULE_CANFD_TO_UART_RING_SIZE - tail;
+}
+
+static uint32_t ring_write(FDCanToUart::TxRing& ring, uint32_t pos,
+                           const uint8_t* data, size_t size) {
+  size_t first = MODULE_CANFD_TO_UART_RING_SIZE - pos;
+  if (first > size) {
+    first = size;
+  }
+
+  memcpy(ring.buff + pos, data, first);
+  memcpy(ring.buff, data + first, size - first);
+
+  pos += size;
+  if (pos >= MODULE_CANFD_TO_UART_RING_SIZE) {
+    pos -= MODULE_CANFD_TO_UART_RING_SIZE;
+  }
+  return pos;
+}
+
+static uint32_t ring_read(FDCanToUart::TxRing& ring, uint32_t pos,
+                          uint8_t* data, size_t size) {
+  size_t first = MODULE_CANFD_TO_UART_RING_SIZE - pos;
+  if (first > size) {
+    first = size;
+  }
+
+  memcpy(data, ring.buff + pos, first);
+  memcpy(data + first, ring.buff, size - first);
+
+  pos += size;
+  if (pos >= MODULE_CANFD_TO_UART_RING_SIZE) {
+    pos -= MODULE_CANFD_TO_UART_RING_SIZE;
+  }
+  return pos;
+}
+
+FDCanToUart::FDCanToUart()
+    : tx_busy_(false),
+      rx_lap_(0),
+      rx_error_(false),
+      cmd_(this, ShowCMD, "canfd_to_uart") {
+  self_ = this;
+
+  Message::Topic<Device::Can::FDPack>* fd_tp[BSP_CAN_NUM];
+  Message::Topic<Device::Can::Pack>* tp[BSP_CAN_NUM];
+
+  for (int i = 0; i < BSP_CAN_NUM; i++) {
+    can_id_[i] = i;
+    tx_ring_[i].head = 0;
+    tx_ring_[i].tail = 0;
+    tx_ring_[i].frame = 0;
+    tx_ring_[i].drop = 0;
+    tx_ring_[i].max_used = 0;
+    can_queue_[i].head = 0;
+    can_queue_[i].size = 0;
+    can_queue_[i].max_size = 0;
+    can_queue_[i].frame_count = 0;
+  }
+
+  /* 缓冲区中的数据仍够一次完整的发送时直接接着发，否则等待超时 */
+  auto uart_tx_cplt_cb = [](void* arg) {
+    FDCanToUart* self = static_cast<FDCanToUart*>(arg);
+
+    if (self->Pending() < MODULE_CANFD_TO_UART_BURST_SIZE || !self->Pump()) {
+      self->tx_busy_ = false;
+    }
+  };
+
+  auto uart_rx_cplt_cb = [](void* arg) {
+    FDCanToUart* self = static_cast<FDCanToUart*>(arg);
+
+    /* 只在中断中写入，无需原子读改写 */
+    self->rx_lap_.store(self->rx_lap_.load(std::memory_order_relaxed) + 1,
+                        std::memory_order_release);
+  };
+
+  /* 溢出、帧错误等会使HAL停止DMA接收，交给Parse()重新启动 */
+  auto uart_error_cb = [](void* arg) {
+    FDCanToUart* self = static_cast<FDCanToUart*>(arg);
+
+    self->rx_error_.store(true, std::memory_order_release);
+  };
+
+  bsp_uart_register_callback(BSP_UART_MCU, BSP_UART_RX_CPLT_CB,
+                             uart_rx_cplt_cb, this);
+
+  bsp_uart_register_callback(BSP_UART_MCU, BSP_UART_ERROR_CB, uart_error_cb,
+                             this);
+
+  bsp_uart_register_callback(BSP_UART_MCU, BSP_UART_TX_CPLT_CB,
+                             uart_tx_cplt_cb, this);
+
+  auto canfd_rx_fun = [](Device::Can::FDPack& pack, uint8_t* can) {
+    self_->Push(*can, true, pack.index, pack.time, pack.info.data,
+                pack.info.size);
+    return false;
+  };
+
+  auto can_rx_fun = [](Device::Can::Pack& pack, uint8_t* can) {
+    self_->Push(*can, false, pack.index, pack.time, pack.data,
+                sizeof(pack.data));
+    return false;
+  };
+
+  for (int i = 0; i < BSP_CAN_NUM; i++) {
+    fd_tp[i] = new Message::Topic<Device::Can::FDPack>(
+        (std::string("trans_canfd") + std::to_string(i)).c_str());
+    tp[i] = new Message::Topic<Device::Can::Pack>(
+        (std::string("trans_can") + std::to_string(i)).c_str());
+
+    Device::Can::SubscribeFD(*fd_tp[i], static_cast<bsp_can_t>(i), 0,
+                             UINT32_MAX);
+
+    Device::Can::Subscribe(*tp[i], static_cast<bsp_can_t>(i), 0, UINT32_MAX);
+
+    fd_tp[i]->RegisterCallback(canfd_rx_fun, &can_id_[i]);
+    tp[i]->RegisterCallback(can_rx_fun, &can_id_[i]);
+  }
+
+  /* 未攒满一次发送的数据最多等待一个周期 */
+  auto flush_fn = [](FDCanToUart* self) {
+    if (self->tx_busy_) {
+      if (self->Pending() > 0) {
+        self->backpressure_++;
+      }
+      return;
+    }
+
+    /* 发送完成中断只在DMA发送期间产生，此时不会与之竞争 */
+    self->tx_busy_ = true;
+    if (!self->Pump()) {
+      self->tx_busy_ = false;
+    }
+  };
+
+  flush_timer_ = System::Timer::CreateMicroseconds(
+      flush_fn, this, MODULE_CANFD_TO_UART_FLUSH_US, System::Timer::PERIODIC,
+      "canfd_to_uart");
+
+  auto parse_fn = [](FDCanToUart* self) { self->Parse(); };
+
+  parse_timer_ = System::Timer::CreateMicroseconds(
+      parse_fn, this, MODULE_CANFD_TO_UART_PARSE_US, System::Timer::PERIODIC,
+      "uart_to_canfd");
+
+  bsp_uart_receive_circular(BSP_UART_MCU, rx_buff_, sizeof(rx_buff_));
+}
+
+bool FDCanToUart::Push(uint8_t can, bool fd, uint32_t index, uint64_t time,
+                       const uint8_t* data, size_t size) {
+  TxRing& ring = tx_ring_[can];
+
+  /* 长度字段只有6位，64字节的CAN FD帧无法编码 */
+  if (size > 63) {
+    ring.drop++;
+    return false;
+  }
+
+  uint32_t head = ring.head.load(std::memory_order_relaxed);
+  uint32_t tail = ring.tail.load(std::memory_order_acquire);
+  uint32_t used = ring_used(head, tail);
+  size_t len = sizeof(UartDataHeader) + size + sizeof(uint8_t);
+
+  /* 保留一个字节区分空和满 */
+  if (MODULE_CANFD_TO_UART_RING_SIZE - 1 - used < len) {
+    ring.drop++;
+    return false;
+  }
+
+  UartDataHeader header;
+  header.prefix = 0xa5;
+  header.id = can;
+  header.index = index;
+  header.time = static_cast<uint32_t>(time);
+  header.data_len = size;
+  header.ext = 0;
+  header.fd = fd;
+  header.crc8 = Component::CRC8::Calculate(
+      reinterpret_cast<uint8_t*>(&header),
+      sizeof(UartDataHeader) - sizeof(uint8_t), CRC8_INIT);
+
+  uint8_t crc = Component::CRC8::Calculate(
+      data, size,
+      Component::CRC8::Calculate(reinterpret_cast<uint8_t*>(&header),
+                                 sizeof(UartDataHeader), CRC8_INIT));
+
+  head = ring_write(ring, head, reinterpret_cast<uint8_t*>(&header),
+                    sizeof(UartDataHeader));
+  head = ring_write(ring, head, data, size);
+  head = ring_write(ring, head, &crc, sizeof(crc));
+
+  ring.head.store(head, std::memory_order_release);
+
+  ring.frame++;
+  if (used + len > ring.max_used) {
+    ring.max_used = used + len;
+  }
+
+  return true;
+}
+
+bool FDCanToUart::Pump() {
+  uint32_t len = 0, frame = 0;
+
+  /* 每次从不同的总线开始取，避免一路总线占满所有发送 */
+  for (int i = 0; i < BSP_CAN_NUM; i++) {
+    TxRing& ring = tx_ring_[(next_bus_ + i) % BSP_CAN_NUM];
+
+    uint32_t head = ring.head.load(std::memory_order_acquire);
+    uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+
+    while (tail != head) {
+      UartDataHeader header;
+      ring_read(ring, tail, reinterpret_cast<uint8_t*>(&header),
+                sizeof(header));
+
+      uint32_t frame_len = sizeof(header) + header.data_len + sizeof(uint8_t);
+      if (len + frame_len > MODULE_CANFD_TO_UART_BURST_SIZE) {
+        break;
+      }
+
+      tail = ring_read(ring, tail, tx_burst_ + len, frame_len);
+      len += frame_len;
+      frame++;
+    }
+
+    ring.tail.store(tail, std::memory_order_release);
+  }
+
+  next_bus_ = (next_bus_ + 1) % BSP_CAN_NUM;
+
+  if (len == 0) {
+    return false;
+  }
+
+  burst_count_++;
+  burst_byte_ += len;
+  burst_frame_ += frame;
+
+  return bsp_uart_transmit(BSP_UART_MCU, tx_burst_, len, false) == BSP_OK;
+}
+
+uint32_t FDCanToUart::Pending() {
+  uint32_t pending = 0;
+
+  for (int i = 0; i < BSP_CAN_NUM; i++) {
+    pending += ring_used(tx_ring_[i].head.load(std::memory_order_acquire),
+                         tx_ring_[i].tail.load(std::memory_order_relaxed));
+  }
+
+  return pending;
+}
+
+void FDCanToUart::RxPeek(uint32_t pos, uint8_t* data, size_t size) {
+  if (pos >= MODULE_CANFD_TO_UART_RX_BUFF_SIZE) {
+    pos -= MODULE_CANFD_TO_UART_RX_BUFF_SIZE;
+  }
+
+  size_t first = MODULE_CANFD_TO_UART_RX_BUFF_SIZE - pos;
+  if (first > size) {
+    first = size;
+  }
+
+  memcpy(data, rx_buff_ + pos, first);
+  memcpy(data + first, rx_buff_, size - first);
+}
+
+void FDCanToUart::RxSkip(uint32_t size) {
+  rx_pos_ += size;
+  if (rx_pos_ >= MODULE_CANFD_TO_UART_RX_BUFF_SIZE) {
+    rx_pos_ -= MODULE_CANFD_TO_UART_RX_BUFF_SIZE;
+  }
+  rx_read_ += size;
+}
+
+void FDCanToUart::RxRestart() {
+  /* 先清除标志，重新启动期间再次出错时下一次仍会处理 */
+  rx_error_.store(false, std::memory_order_relaxed);
+
+  /* 接收已经停止，缓冲区中未解析的数据直接丢弃 */
+  uint32_t pos = bsp_uart_get_count(BSP_UART_MCU);
+  if (pos >= MODULE_CANFD_TO_UART_RX_BUFF_SIZE) {
+    pos = 0;
+  }
+
+  uint64_t total =
+      static_cast<uint64_t>(rx_lap_.load(std::memory_order_acquire)) *
+          MODULE_CANFD_TO_UART_RX_BUFF_SIZE +
+      pos;
+  if (total > rx_read_) {
+    rx_drop_byte_ += total - rx_read_;
+  }
+
+  rx_lap_.store(0, std::memory_order_relaxed);
+  rx_pos_ = 0;
+  rx_read_ = 0;
+  rx_sync_ = false;
+  rx_restart_++;
+
+  bsp_uart_receive_circular(BSP_UART_MCU, rx_buff_, sizeof(rx_buff_));
+}
+
+void FDCanToUart::Parse() {
+  DrainCan();
+
+  if (rx_error_.load(std::memory_order_acquire)) {
+    RxRestart();
+  }
+
+  /* DMA写入位置与回卷次数需要一致，期间发生回卷时重新读取 */
+  uint32_t lap = 0, pos = 0;
+  do {
+    lap = rx_lap_.load(std::memory_order_acquire);
+    pos = bsp_uart_get_count(BSP_UART_MCU);
+  } while (lap != rx_lap_.load(std::memory_order_acquire));
+
+  if (pos >= MODULE_CANFD_TO_UART_RX_BUFF_SIZE) {
+    pos = 0;
+  }
+
+  uint64_t total =
+      static_cast<uint64_t>(lap) * MODULE_CANFD_TO_UART_RX_BUFF_SIZE + pos;
+
+  /* 已经回卷但接收完成中断还未处理 */
+  if (total < rx_read_) {
+    total += MODULE_CANFD_TO_UART_RX_BUFF_SIZE;
+  }
+
+  uint64_t avail = total - rx_read_;
+
+  if (avail >= MODULE_CANFD_TO_UART_RX_BUFF_SIZE) {
+    rx_overrun_++;
+    rx_drop_byte_ += avail;
+    rx_read_ = total;
+    rx_pos_ = pos;
+    rx_sync_ = false;
+    return;
+  }
+
+  while (avail >= sizeof(UartDataHeader) + sizeof(uint8_t)) {
+    if (rx_buff_[rx_pos_] != 0xa5) {
+      rx_sync_ = false;
+      rx_drop_byte_++;
+      RxSkip(1);
+      avail--;
+      continue;
+    }
+
+    UartDataHeader header;
+    RxPeek(rx_pos_, reinterpret_cast<uint8_t*>(&header), sizeof(header));
+
+    /* 帧头校验失败只丢弃前缀字节，从下一个字节开始重新同步 */
+    if (Component::CRC8::Calculate(reinterpret_cast<uint8_t*>(&header),
+                                   sizeof(header) - sizeof(uint8_t),
+                                   CRC8_INIT) != header.crc8 ||
+        header.id >= BSP_CAN_NUM) {
+      rx_crc_error_++;
+      rx_sync_ = false;
+      rx_drop_byte_++;
+      RxSkip(1);
+      avail--;
+      continue;
+    }
+
+    uint32_t len = sizeof(header) + header.data_len + sizeof(uint8_t);
+    if (avail < len) {
+      break;
+    }
+
+    CanQueue& queue = can_queue_[header.id];
+    if (queue.size >= MODULE_CANFD_TO_UART_CAN_QUEUE_LEN) {
+      rx_backpressure_++;
+      break;
+    }
+
+    CanFrame& frame =
+        queue.frame[(queue.head + queue.size) %
+                    MODULE_CANFD_TO_UART_CAN_QUEUE_LEN];
+    uint8_t crc8 = 0;
+    RxPeek(rx_pos_ + sizeof(header), frame.data, header.data_len);
+    RxPeek(rx_pos_ + len - sizeof(uint8_t), &crc8, sizeof(crc8));
+
+    uint8_t crc = Component::CRC8::Calculate(
+        frame.data, header.data_len,
+        Component::CRC8::Calculate(reinterpret_cast<uint8_t*>(&header),
+                                   sizeof(header), CRC8_INIT));
+    if (crc != crc8) {
+      rx_crc_error_++;
+      rx_sync_ = false;
+      rx_drop_byte_++;
+      RxSkip(1);
+      avail--;
+      continue;
+    }
+
+    frame.id = header.index;
+    frame.size = header.data_len;
+    frame.fd = header.fd;
+    frame.ext = header.ext;
+
+    queue.size++;
+    if (queue.size > queue.max_size) {
+      queue.max_size = queue.size;
+    }
+
+    /* 丢失同步后重新找到完整的帧 */
+    if (!rx_sync_) {
+      rx_sync_ = true;
+      rx_resync_++;
+    }
+
+    RxSkip(len);
+    avail -= len;
+  }
+
+  DrainCan();
+}
+
+void FDCanToUart::DrainCan() {
+  for (int i = 0; i < BSP_CAN_NUM; i++) {
+    CanQueue& queue = can_queue_[i];
+    bsp_can_t can = static_cast<bsp_can_t>(i);
+
+    while (queue.size > 0 && Device::Can::TxFree(can) > 0) {
+      CanFrame& frame = queue.frame[queue.head];
+      bsp_can_format_t format = frame.ext ? CAN_FORMAT_EXT : CAN_FORMAT_STD;
+
+      bool ans = false;
+      if (frame.fd) {
+        ans = Device::Can::SendFDPack(can, format, frame.id, frame.data,
+                                      frame.size);
+      } else {
+        Device::Can::Pack pack = {};
+        pack.index = frame.id;
+        memcpy(pack.data, frame.data, sizeof(pack.data));
+        ans = Device::Can::SendPack(can, format, pack);
+      }
+
+      /* 发送队列被其他模块抢先占满，下次再试 */
+      if (!ans) {
+        break;
+      }
+
+      queue.head = (queue.head + 1) % MODULE_CANFD_TO_UART_CAN_QUEUE_LEN;
+      queue.size--;
+      queue.frame_count++;
+    }
+  }
+}
+
+int FDCanToUart::ShowCMD(FDCanToUart* self, int argc, char** argv) {
+  if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+    for (int i = 0; i < BSP_CAN_NUM; i++) {
+      self->tx_ring_[i].frame = 0;
+      self->tx_ring_[i].drop = 0;
+      self->tx_ring_[i].max_used = 0;
+      self->can_queue_[i].max_size = 0;
+      self->can_queue_[i].frame_count = 0;
+    }
+    self->rx_crc_error_ = 0;
+    self->rx_resync_ = 0;
+    self->rx_drop_byte_ = 0;
+    self->rx_overrun_ = 0;
+    self->rx_backpressure_ = 0;
+    self->rx_restart_ = 0;
+    self->burst_count_ = 0;
+    self->burst_byte_ = 0;
+    self->burst_frame_ = 0;
+    self->backpressure_ = 0;
+    return 0;
+  }
+
+  if (argc != 1) {
+    printf("[reset] 清空统计数据\r\n");
+    return 0;
+  }
+
+  printf("%-6s %10s %10s %14s\r\n", "bus", "frame", "drop", "ring max(B)");
+
+  for (int i = 0; i < BSP_CAN_NUM; i++) {
+    printf("%-6d %10u %10u %9u/%-4u\r\n", i,
+           static_cast<unsigned int>(self->tx_ring_[i].frame),
+           static_cast<unsigned int>(self->tx_ring_[i].drop),
+           static_cast<unsigned int>(self->tx_ring_[i].max_used),
+           static_cast<unsigned int>(MODULE_CANFD_TO_UART_RING_SIZE));
+  }
+
+  printf("%10s %10s %12s %14s\r\n", "burst", "byte", "frame/burst",
+         "backpressure");
+  printf("%10u %10u %12u %14u\r\n",
+         static_cast<unsigned int>(self->burst_count_),
+         static_cast<unsigned int>(self->burst_byte_),
+         static_cast<unsigned int>(
+             self->burst_count_ ? self->burst_frame_ / self->burst_count_ : 0),
+         static_cast<unsigned int>(self->backpressure_));
+
+  printf("\r\n%-6s %10s %14s\r\n", "bus", "to can", "queue max");
+
+  for (int i = 0; i < BSP_CAN_NUM; i++) {
+    printf("%-6d %10u %9u/%-4u\r\n", i,
+           static_cast<unsigned int>(self->can_queue_[i].frame_count),
+           static_cast<unsigned int>(self->can_queue_[i].max_size),
+           static_cast<unsigned int>(MODULE_CANFD_TO_UART_CAN_QUEUE_LEN));
+  }
+
+  printf("%10s %10s %10s %10s %14s %10s\r\n", "crc error", "resync",
+         "drop(B)", "overrun", "backpressure", "restart");
+  printf("%10u %10u %10u %10u %14u %10u\r\n",
+         static_cast<unsigned int>(self->rx_crc_error_),
+         static_cast<unsigned int>(self->rx_resync_),
+         static_cast<unsigned int>(self->rx_drop_byte_),
+         static_cast<unsigned int>(self->rx_overrun_),
+         static_cast<unsigned int>(self->rx_backpressure_),
+         static_cast<unsigned int>(self->rx_restart_));
+
+  return 0;
+}
@@ -1,3 +1,5 @@
+#include <atomic>
+
 #include "bsp_uart.h"
 #include "comp_crc8.hpp"
 #include "dev_can.hpp"
@@ -10,188 +12,108 @@ class FDCanToUart {
     uint8_t prefix;
     uint8_t id;
     uint32_t index;
+    uint32_t time; /* CAN接收时间的低32位 单位：us，主机发出的帧中不使用 */
     uint8_t data_len : 6;
     uint8_t ext : 1;
     uint8_t fd : 1;
     uint8_t crc8;
   } UartDataHeader;
 
-  FDCanToUart() : uart_received(0), uart_sent(1) {
-    self_ = this;
-
-    om_fifo_create(&uart_rx_fifo, new uint8_t[256], 256, sizeof(uint8_t));
-
-    Message::Topic<Device::Can::FDPack>* fd_tp[BSP_CAN_NUM];
-    Message::Topic<Device::Can::Pack>* tp[BSP_CAN_NUM];
-
-    for (int i = 0; i < BSP_CAN_NUM; i++) {
-      can_id_[i] = i;
-      curr_uart_tx_buff[i] = uart_tx_buff[i][0];
-    }
-
-    auto uart_tx_cplt_cb = [](void* arg) {
-      XB_UNUSED(arg);
-      self_->uart_sent.Post();
-    };
-
-    auto uart_rx_cplt_cb = [](void* arg) {
-      XB_UNUSED(arg);
-      bsp_uart_abort_receive(BSP_UART_MCU);
-      om_fifo_writes(&self_->uart_rx_fifo, self_->uart_rx_buff,
-                     bsp_uart_get_count(BSP_UART_MCU));
-
-      bsp_uart_receive(BSP_UART_MCU, self_->uart_rx_buff,
-                       sizeof(self_->uart_rx_buff), false);
-      static uint8_t prase_buff[sizeof(UartDataHeader) + 65] = {};
-      UartDataHeader* header = reinterpret_cast<UartDataHeader*>(&prase_buff);
-      uint32_t len = om_fifo_readable_item_count(&self_->uart_rx_fifo);
-      while (len > sizeof(UartDataHeader) + sizeof(uint8_t)) {
-        om_fifo_peek(&self_->uart_rx_fifo, header);
-        if (header->prefix != 0xa5) {
-          om_fifo_pop(&self_->uart_rx_fifo);
-          len--;
-          continue;
-        }
-
-        om_fifo_reads(&self_->uart_rx_fifo, prase_buff, sizeof(UartDataHeader));
-        len -= sizeof(UartDataHeader);
-        if (!Component::CRC8::Verify(prase_buff, sizeof(UartDataHeader))) {
-        };
-
-        if (header->data_len + 1 > len) {
-          continue;
-        }
-
-        om_fifo_reads(&self_->uart_rx_fifo, prase_buff + sizeof(UartDataHeader),
-                      header->data_len + 1);
-        len -= header->data_len + 1;
-        if (!Component::CRC8::Verify(
-                prase_buff, sizeof(UartDataHeader) + header->data_len + 1)) {
-          continue;
-        }
-
-        static Device::Can::FDPack pack = {};
-        pack.info.size = header->data_len;
-        pack.info.data = prase_buff + sizeof(UartDataHeader);
-        pack.index = header->index;
-
-        if (header->fd) {
-          Device::Can::SendFDPack(
-              static_cast<bsp_can_t>(header->id),
-              header->ext ? CAN_FORMAT_EXT : CAN_FORMAT_STD, header->index,
-              prase_buff + sizeof(UartDataHeader), header->data_len);
-        } else {
-          static Device::Can::Pack pack = {};
-          memcpy(pack.data, prase_buff + sizeof(UartDataHeader), 8);
-          pack.index = header->index;
-          Device::Can::SendPack(static_cast<bsp_can_t>(header->id),
-                                header->ext ? CAN_FORMAT_EXT : CAN_FORMAT_STD,
-                                pack);
-        }
-      }
-    };
-
-    bsp_uart_register_callback(BSP_UART_MCU, BSP_UART_IDLE_LINE_CB,
-                               uart_rx_cplt_cb, this);
-
-    bsp_uart_register_callback(BSP_UART_MCU, BSP_UART_TX_CPLT_CB,
-                               uart_tx_cplt_cb, this);
-
-    auto canfd_rx_fun = [](Device::Can::FDPack& pack, uint8_t* can) {
-      XB_ASSERT(pack.info.size <= 64);
-
-      if (self_->curr_uart_tx_buff[*can] == self_->uart_tx_buff[*can][0]) {
-        self_->curr_uart_tx_buff[*can] = self_->uart_tx_buff[*can][1];
-      } else {
-        self_->curr_uart_tx_buff[*can] = self_->uart_tx_buff[*can][0];
-      }
-
-      uint8_t* buff = self_->curr_uart_tx_buff[*can];
-      UartDataHeader* header = reinterpret_cast<UartDataHeader*>(buff);
-      buff += sizeof(UartDataHeader);
-
-      header->prefix = 0xa5;
-      header->data_len = pack.info.size;
-      header->id = *can;
-      header->index = pack.index;
-      header->fd = true;
-      header->crc8 = Component::CRC8::Calculate(
-          reinterpret_cast<uint8_t*>(header),
-          sizeof(UartDataHeader) - sizeof(uint8_t), CRC8_INIT);
-      memcpy(buff, pack.info.data, pack.info.size);
-      buff += pack.info.size;
-      *buff = Component::CRC8::Calculate(
-          reinterpret_cast<uint8_t*>(header),
-          sizeof(UartDataHeader) + pack.info.size, CRC8_INIT);
-      if (self_->uart_sent.Wait(UINT32_MAX)) {
-        bsp_uart_transmit(
-            BSP_UART_MCU, reinterpret_cast<uint8_t*>(header),
-            sizeof(UartDataHeader) + pack.info.size + sizeof(uint8_t), false);
-      }
-      return false;
-    };
-
-    auto can_rx_fun = [](Device::Can::Pack& pack, uint8_t* can) {
-      if (self_->curr_uart_tx_buff[*can] == self_->uart_tx_buff[*can][0]) {
-        self_->curr_uart_tx_buff[*can] = self_->uart_tx_buff[*can][1];
-      } else {
-        self_->curr_uart_tx_buff[*can] = self_->uart_tx_buff[*can][0];
-      }
-
-      uint8_t* buff = self_->curr_uart_tx_buff[*can];
-      UartDataHeader* header = reinterpret_cast<UartDataHeader*>(buff);
-      buff += sizeof(UartDataHeader);
-
-      header->prefix = 0xa5;
-      header->data_len = 8;
-      header->id = *can;
-      header->index = pack.index;
-      header->fd = false;
-      header->crc8 = Component::CRC8::Calculate(
-          reinterpret_cast<uint8_t*>(header),
-          sizeof(UartDataHeader) - sizeof(uint8_t), CRC8_INIT);
-      memcpy(buff, pack.data, 8);
-      buff += 8;
-      *buff = Component::CRC8::Calculate(reinterpret_cast<uint8_t*>(header),
-                                         sizeof(UartDataHeader) + 8, CRC8_INIT);
-      if (self_->uart_sent.Wait(UINT32_MAX)) {
-        bsp_uart_transmit(BSP_UART_MCU, buff,
-                          sizeof(UartDataHeader) + 8 + sizeof(uint8_t), false);
-      }
-      return false;
-    };
-
-    for (int i = 0; i < BSP_CAN_NUM; i++) {
-      fd_tp[i] = new Message::Topic<Device::Can::FDPack>(
-          (std::string("trans_canfd") + std::to_string(i)).c_str());
-      tp[i] = new Message::Topic<Device::Can::Pack>(
-          (std::string("trans_can") + std::to_string(i)).c_str());
-
-      Device::Can::SubscribeFD(*fd_tp[i], static_cast<bsp_can_t>(i), 0,
-                               UINT32_MAX);
-
-      Device::Can::Subscribe(*tp[i], static_cast<bsp_can_t>(i), 0, UINT32_MAX);
-
-      fd_tp[i]->RegisterCallback(canfd_rx_fun, &can_id_[i]);
-      tp[i]->RegisterCallback(can_rx_fun, &can_id_[i]);
-    }
-
-    bsp_uart_receive(BSP_UART_MCU, self_->uart_rx_buff,
-                     sizeof(self_->uart_rx_buff), false);
-  }
-
-  struct __attribute__((packed)) {
-    UartDataHeader header;
-    uint8_t buff[65];
-  } can_buff_[BSP_CAN_NUM];
-
-  uint8_t* curr_uart_tx_buff[BSP_CAN_NUM];
-
-  uint8_t uart_rx_buff[256] = {};
-  uint8_t uart_tx_buff[BSP_CAN_NUM][2][256] = {};
-
-  System::Semaphore uart_received, uart_sent;
-  om_fifo_t uart_rx_fifo;
+  /* 单路CAN到串口的环形缓冲区，存放已编码好的串口帧。
+   * 生产者为该路CAN的接收中断，只写head；消费者为持有tx_busy_的一方，
+   * 只写tail，因此无需关中断或原子读改写 */
+  typedef struct {
+    uint8_t buff[MODULE_CANFD_TO_UART_RING_SIZE];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    uint32_t frame;    /* 写入的帧数 */
+    uint32_t drop;     /* 缓冲区已满或长度无法编码而丢弃的帧数 */
+    uint32_t max_used; /* 最大占用 单位：字节 */
+  } TxRing;
+
+  /* 串口解析出的待转发帧 */
+  typedef struct {
+    uint32_t id;
+    uint8_t size;
+    bool fd;
+    bool ext;
+    uint8_t data[64];
+  } CanFrame;
+
+  /* 单路CAN的待转发队列，只在主循环中访问。
+   * 队列已满时暂停解析，数据留在串口接收缓冲区中 */
+  typedef struct {
+    CanFrame frame[MODULE_CANFD_TO_UART_CAN_QUEUE_LEN];
+    uint32_t head;
+    uint32_t size;
+    uint32_t max_size;
+    uint32_t frame_count; /* 交给Device::Can的帧数 */
+  } CanQueue;
+
+  FDCanToUart();
+
+  static int ShowCMD(FDCanToUart* self, int argc, char** argv);
+
+ private:
+  /* 编码为串口帧写入环形缓冲区，在CAN接收中断中调用 */
+  bool Push(uint8_t can, bool fd, uint32_t index, uint64_t time,
+            const uint8_t* data, size_t size);
+
+  /* 按帧从各路环形缓冲区取出数据，拼成一次DMA发送。
+   * 只由持有tx_busy_的一方调用，返回是否启动了发送 */
+  bool Pump();
+
+  uint32_t Pending();
+
+  /* 解析串口接收缓冲区中的新数据，放入对应总线的转发队列 */
+  void Parse();
+
+  /* 按Device::Can发送队列的剩余空间转发 */
+  void DrainCan();
+
+  void RxPeek(uint32_t pos, uint8_t* data, size_t size);
+
+  void RxSkip(uint32_t size);
+
+  /* 重新启动DMA循环接收，从缓冲区开头解析 */
+  void RxRestart();
+
+  TxRing tx_ring_[BSP_CAN_NUM];
+
+  uint8_t tx_burst_[MODULE_CANFD_TO_UART_BURST_SIZE];
+
+  /* DMA发送中，由定时器置位，由发送完成中断清除或继续下一次发送 */
+  std::atomic<bool> tx_busy_;
+
+  uint8_t next_bus_ = 0;
+
+  uint32_t burst_count_ = 0;
+  uint32_t burst_byte_ = 0;
+  uint32_t burst_frame_ = 0;
+  uint32_t backpressure_ = 0; /* 超时需要发送但上一次DMA尚未完成的次数 */
+
+  /* DMA循环接收缓冲区，rx_lap_由接收完成中断在每次回卷时加一 */
+  uint8_t rx_buff_[MODULE_CANFD_TO_UART_RX_BUFF_SIZE];
+  std::atomic<uint32_t> rx_lap_;
+  /* 由串口错误中断置位，由Parse()清除并重新启动接收 */
+  std::atomic<bool> rx_error_;
+  uint32_t rx_pos_ = 0;  /* 下一个待解析字节的位置 */
+  uint64_t rx_read_ = 0; /* 累计解析的字节数 */
+  bool rx_sync_ = true;
+
+  CanQueue can_queue_[BSP_CAN_NUM];
+
+  uint32_t rx_crc_error_ = 0;
+  uint32_t rx_resync_ = 0; /* 丢失同步后重新找到帧头的次数 */
+  uint32_t rx_drop_byte_ = 0;
+  uint32_t rx_overrun_ = 0;      /* 解析不及时，接收缓冲区被覆盖的次数 */
+  uint32_t rx_backpressure_ = 0; /* 转发队列已满暂停解析的次数 */
+  uint32_t rx_restart_ = 0;      /* 串口出错后重新启动接收的次数 */
+
+  System::Timer::TimerHandle flush_timer_;
+  System::Timer::TimerHandle parse_timer_;
+
+  System::Term::Command<FDCanToUart*> cmd_;
 
   uint8_t can_id_[BSP_CAN_NUM];
 
@@ -9,16 +9,14 @@ using namespace Module;
 DartLauncher::DartLauncher(DartLauncher::Param& param, float control_freq)
     : param_(param),
       rod_actr_(param.rod_actr, control_freq, 500.0f),
-      reload_actr_(param.reload_actr, control_freq, 500.0f) {
+      reload_actr_(param.reload_actr, control_freq, 500.0f),
+      fric_motor_(param.fric_motor, "dart_fric") {
   this->setpoint_.rod = 0.1;
   this->setpoint_.reload = 0.0f;
 
   for (int i = 0; i < 4; i++) {
     fric_actr_[i] =
         new Component::SpeedActuator(param.fric_actr[i], control_freq);
-    fric_motor_[i] = new Device::RMMotor(
-        param.fric_motor[i],
-        (std::string("dart_fric_") + std::to_string(i)).c_str());
   }
 
   auto event_callback = [](Event event, DartLauncher* dart) {
@@ -69,9 +67,7 @@ DartLauncher::DartLauncher(DartLauncher::Param& param, float control_freq)
 void DartLauncher::UpdateFeedback() {
   this->rod_actr_.UpdateFeedback();
   this->reload_actr_.UpdateFeedback();
-  for (auto motor : fric_motor_) {
-    motor->Update();
-  }
+  this->fric_motor_.Update();
 }
 
 void DartLauncher::Control() {
@@ -90,10 +86,8 @@ void DartLauncher::Control() {
   for (int i = 0; i < 4; i++) {
     motor_out_[i] = this->fric_actr_[i]->Calculate(
         this->setpoint_.fric_speed,
-        this->fric_motor_[i]->GetSpeed() / MAX_FRIC_SPEED, dt_);
+        this->fric_motor_.GetSpeed(i) / MAX_FRIC_SPEED, dt_);
   }
 
-  for (int i = 0; i < 4; i++) {
-    this->fric_motor_[i]->Control(motor_out_[i]);
-  }
+  this->fric_motor_.Control(motor_out_);
 }
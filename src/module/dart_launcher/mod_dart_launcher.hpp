@@ -3,6 +3,7 @@
 
 #include "comp_cmd.hpp"
 #include "dev_mech.hpp"
+#include "dev_motor_bank.hpp"
 #include "dev_rm_motor.hpp"
 #include "module.hpp"
 
@@ -58,7 +59,7 @@ class DartLauncher {
       reload_actr_;
 
   std::array<Component::SpeedActuator*, 4> fric_actr_;
-  std::array<Device::RMMotor*, 4> fric_motor_;
+  Device::MotorBank<Device::RMMotor, 4> fric_motor_;
 
   std::array<float, 4> motor_out_;
 
@@ -19,8 +19,7 @@ Gimbal::Gimbal(Param& param, float control_freq)
       st_(param.st),
       yaw_actuator_(this->param_.yaw_actr, control_freq),
       pit_actuator_(this->param_.pit_actr, control_freq),
-      yaw_motor_(this->param_.yaw_motor, "Gimbal_Yaw"),
-      pit_motor_(this->param_.pit_motor, "Gimbal_Pitch"),
+      motor_({this->param_.yaw_motor, this->param_.pit_motor}, "gimbal"),
       ctrl_lock_(true) {
   auto event_callback = [](GimbalEvent event, Gimbal* gimbal) {
     gimbal->ctrl_lock_.Wait(UINT32_MAX);
@@ -79,10 +78,10 @@ Gimbal::Gimbal(Param& param, float control_freq)
 }
 
 void Gimbal::UpdateFeedback() {
-  this->pit_motor_.Update();
-  this->yaw_motor_.Update();
+  this->motor_.Update();
 
-  this->yaw_ = this->yaw_motor_.GetAngle() - this->param_.mech_zero.yaw;
+  this->yaw_ =
+      this->motor_.GetAngle(GIMBAL_MOTOR_YAW) - this->param_.mech_zero.yaw;
 }
 
 void Gimbal::Control() {
@@ -111,9 +110,9 @@ void Gimbal::Control() {
 
   /* 处理pitch控制命令，软件限位 */
   const float ENCODER_DELTA_MAX =
-      this->param_.limit.pitch_max - this->pit_motor_.GetAngle();
+      this->param_.limit.pitch_max - this->motor_.GetAngle(GIMBAL_MOTOR_PIT);
   const float ENCODER_DELTA_MIN =
-      this->param_.limit.pitch_min - this->pit_motor_.GetAngle();
+      this->param_.limit.pitch_min - this->motor_.GetAngle(GIMBAL_MOTOR_PIT);
   const float PIT_ERR = this->setpoint_.eulr_.pit - eulr_.pit;
   const float DELTA_MAX = ENCODER_DELTA_MAX - PIT_ERR;
   const float DELTA_MIN = ENCODER_DELTA_MIN - PIT_ERR;
@@ -123,8 +122,7 @@ void Gimbal::Control() {
   /* 控制相关逻辑 */
   switch (this->mode_) {
     case RELAX:
-      this->yaw_motor_.Relax();
-      this->pit_motor_.Relax();
+      this->motor_.Relax();
       break;
     case ABSOLUTE:
       /* Yaw轴角速度环参数计算 */
@@ -134,8 +132,8 @@ void Gimbal::Control() {
       float pit_out = this->pit_actuator_.Calculate(
           this->setpoint_.eulr_.pit, this->gyro_.x, this->eulr_.pit, this->dt_);
 
-      this->yaw_motor_.Control(yaw_out);
-      this->pit_motor_.Control(pit_out);
+      /* 两个电机的输出一次写入 */
+      this->motor_.Control({yaw_out, pit_out});
 
       break;
   }
@@ -15,6 +15,7 @@
 #include "comp_pid.hpp"
 #include "dev_ahrs.hpp"
 #include "dev_bmi088.hpp"
+#include "dev_motor_bank.hpp"
 #include "dev_referee.hpp"
 #include "dev_rm_motor.hpp"
 
@@ -35,6 +36,12 @@ class Gimbal {
     GIMBAL_CTRL_NUM,           /* 总共的控制器数量 */
   };
 
+  enum {
+    GIMBAL_MOTOR_YAW = 0, /* Yaw轴电机在motor_中的索引 */
+    GIMBAL_MOTOR_PIT,     /* Pitch轴电机在motor_中的索引 */
+    GIMBAL_MOTOR_NUM,     /* 电机数量 */
+  };
+
   typedef enum {
     SET_MODE_RELAX,
     SET_MODE_ABSOLUTE,
@@ -95,8 +102,7 @@ class Gimbal {
   Component::PosActuator yaw_actuator_;
   Component::PosActuator pit_actuator_;
 
-  Device::RMMotor yaw_motor_;
-  Device::RMMotor pit_motor_;
+  Device::MotorBank<Device::RMMotor, GIMBAL_MOTOR_NUM> motor_;
 
   System::Thread thread_;
 
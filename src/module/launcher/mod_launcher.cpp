@@ -18,24 +18,31 @@
 
 using namespace Module;
 
+static std::array<Device::RMMotor::Param, Launcher::LAUNCHER_MOTOR_NUM>
+motor_param(const Launcher::Param& param) {
+  std::array<Device::RMMotor::Param, Launcher::LAUNCHER_MOTOR_NUM> motor;
+
+  for (size_t i = 0; i < Launcher::LAUNCHER_ACTR_FRIC_NUM; i++) {
+    motor[Launcher::LAUNCHER_MOTOR_FRIC_OFFSET + i] = param.fric_motor.at(i);
+  }
+
+  for (size_t i = 0; i < Launcher::LAUNCHER_ACTR_TRIG_NUM; i++) {
+    motor[Launcher::LAUNCHER_MOTOR_TRIG_OFFSET + i] = param.trig_motor.at(i);
+  }
+
+  return motor;
+}
+
 Launcher::Launcher(Param& param, float control_freq)
-    : param_(param), ctrl_lock_(true) {
+    : param_(param), motor_(motor_param(param), "launcher"), ctrl_lock_(true) {
   for (size_t i = 0; i < LAUNCHER_ACTR_TRIG_NUM; i++) {
     this->trig_actuator_.at(i) =
         new Component::PosActuator(param.trig_actr.at(i), control_freq);
-
-    this->trig_motor_.at(i) =
-        new Device::RMMotor(this->param_.trig_motor.at(i),
-                            ("Launcher_Trig" + std::to_string(i)).c_str());
   }
 
   for (size_t i = 0; i < LAUNCHER_ACTR_FRIC_NUM; i++) {
     this->fric_actuator_.at(i) =
         new Component::SpeedActuator(param.fric_actr.at(i), control_freq);
-
-    this->fric_motor_.at(i) =
-        new Device::RMMotor(this->param_.fric_motor.at(i),
-                            ("Launcher_Fric" + std::to_string(i)).c_str());
   }
 
   auto event_callback = [](LauncherEvent event, Launcher* launcher) {
@@ -110,18 +117,13 @@ Launcher::Launcher(Param& param, float control_freq)
 }
 
 void Launcher::UpdateFeedback() {
-  const float LAST_TRIG_MOTOR_ANGLE = this->trig_motor_[0]->GetAngle();
+  const float LAST_TRIG_MOTOR_ANGLE =
+      this->motor_.GetAngle(LAUNCHER_MOTOR_TRIG_OFFSET);
 
-  for (size_t i = 0; i < LAUNCHER_ACTR_FRIC_NUM; i++) {
-    this->fric_motor_[i]->Update();
-  }
-
-  for (size_t i = 0; i < LAUNCHER_ACTR_TRIG_NUM; i++) {
-    this->trig_motor_[i]->Update();
-  }
+  this->motor_.Update();
 
   const float DELTA_MOTOR_ANGLE =
-      this->trig_motor_[0]->GetAngle() - LAST_TRIG_MOTOR_ANGLE;
+      this->motor_.GetAngle(LAUNCHER_MOTOR_TRIG_OFFSET) - LAST_TRIG_MOTOR_ANGLE;
   this->trig_angle_ += DELTA_MOTOR_ANGLE / this->param_.trig_gear_ratio;
 }
 
@@ -227,36 +229,36 @@ void Launcher::Control() {
 
   switch (this->fire_ctrl_.fire_mode_) {
     case RELAX:
-      for (size_t i = 0; i < LAUNCHER_ACTR_TRIG_NUM; i++) {
-        this->trig_motor_[i]->Relax();
-      }
-      for (size_t i = 0; i < LAUNCHER_ACTR_FRIC_NUM; i++) {
-        this->fric_motor_[i]->Relax();
-      }
+      this->motor_.Relax();
       bsp_pwm_stop(BSP_PWM_LAUNCHER_SERVO);
       break;
 
     case SAFE:
-    case LOADED:
+    case LOADED: {
+      std::array<float, LAUNCHER_MOTOR_NUM> motor_out;
+
       for (int i = 0; i < LAUNCHER_ACTR_TRIG_NUM; i++) {
         /* 控制拨弹电机 */
-        float trig_out = this->trig_actuator_[i]->Calculate(
-            this->setpoint_.trig_angle_,
-            this->trig_motor_[i]->GetSpeed() / LAUNCHER_TRIG_SPEED_MAX,
-            this->trig_angle_, this->dt_);
-
-        this->trig_motor_[i]->Control(trig_out);
+        motor_out[LAUNCHER_MOTOR_TRIG_OFFSET + i] =
+            this->trig_actuator_[i]->Calculate(
+                this->setpoint_.trig_angle_,
+                this->motor_.GetSpeed(LAUNCHER_MOTOR_TRIG_OFFSET + i) /
+                    LAUNCHER_TRIG_SPEED_MAX,
+                this->trig_angle_, this->dt_);
       }
 
       for (size_t i = 0; i < LAUNCHER_ACTR_FRIC_NUM; i++) {
         /* 控制摩擦轮 */
-        float fric_out = this->fric_actuator_[i]->Calculate(
-            this->setpoint_.fric_rpm_[i], this->fric_motor_[i]->GetSpeed(),
-            this->dt_);
-
-        this->fric_motor_[i]->Control(fric_out);
+        motor_out[LAUNCHER_MOTOR_FRIC_OFFSET + i] =
+            this->fric_actuator_[i]->Calculate(
+                this->setpoint_.fric_rpm_[i],
+                this->motor_.GetSpeed(LAUNCHER_MOTOR_FRIC_OFFSET + i),
+                this->dt_);
       }
 
+      /* 所有电机的输出一次写入 */
+      this->motor_.Control(motor_out);
+
       /* 根据弹仓盖开关状态更新弹舱盖打开时舵机PWM占空比 */
       if (this->cover_mode_ == OPEN) {
         bsp_pwm_start(BSP_PWM_LAUNCHER_SERVO);
@@ -266,6 +268,7 @@ void Launcher::Control() {
         bsp_pwm_set_comp(BSP_PWM_LAUNCHER_SERVO, this->param_.cover_close_duty);
       }
       break;
+    }
   }
 }
 
@@ -468,15 +471,16 @@ void Launcher::DrawUIStatic(Launcher* launcher) {
     Device::Referee::AddUI(launcher->rectangle_);
   }
 
+  const float FRIC_SPEED =
+      launcher->motor_.GetSpeed(LAUNCHER_MOTOR_FRIC_OFFSET);
+
   launcher->arc_.Draw(
       "F0", Component::UI::UI_GRAPHIC_OP_ADD,
       Component::UI::UI_GRAPHIC_LAYER_LAUNCHER, Component::UI::UI_GREEN,
-      static_cast<uint16_t>((launcher->fric_motor_[0]->GetSpeed() /
-                             launcher->setpoint_.fric_rpm_[0]) *
+      static_cast<uint16_t>((FRIC_SPEED / launcher->setpoint_.fric_rpm_[0]) *
                             180),
-      360 - static_cast<uint16_t>((launcher->fric_motor_[0]->GetSpeed() /
-                                   launcher->setpoint_.fric_rpm_[0]) *
-                                  180),
+      360 - static_cast<uint16_t>(
+                (FRIC_SPEED / launcher->setpoint_.fric_rpm_[0]) * 180),
       UI_DEFAULT_WIDTH * 5,
       static_cast<uint16_t>(Device::Referee::UIGetWidth() * REF_UI_RIGHT_FRIC),
       static_cast<uint16_t>(Device::Referee::UIGetHeight() *
@@ -586,14 +590,17 @@ void Launcher::DrawUIDynamic(Launcher* launcher) {
     Device::Referee::AddUI(launcher->rectangle_);
   }
 
+  const float FRIC_1_SPEED =
+      launcher->motor_.GetSpeed(LAUNCHER_MOTOR_FRIC_OFFSET);
+  const float FRIC_2_SPEED =
+      launcher->motor_.GetSpeed(LAUNCHER_MOTOR_FRIC_OFFSET + 1);
+
   uint16_t fric_1_sp =
-      180 - static_cast<uint16_t>((launcher->fric_motor_[0]->GetSpeed() /
-                                   launcher->setpoint_.fric_rpm_[0]) *
-                                  180);
+      180 - static_cast<uint16_t>(
+                (FRIC_1_SPEED / launcher->setpoint_.fric_rpm_[0]) * 180);
   uint16_t fric_2_sp =
-      180 + static_cast<uint16_t>((launcher->fric_motor_[1]->GetSpeed() /
-                                   launcher->setpoint_.fric_rpm_[1]) *
-                                  180);
+      180 + static_cast<uint16_t>(
+                (FRIC_2_SPEED / launcher->setpoint_.fric_rpm_[1]) * 180);
 
   Component::UI::Color fric_color = Component::UI::UI_GREEN;
 
@@ -17,6 +17,7 @@
 #include "comp_cmd.hpp"
 #include "comp_filter.hpp"
 #include "comp_pid.hpp"
+#include "dev_motor_bank.hpp"
 #include "dev_referee.hpp"
 #include "dev_rm_motor.hpp"
 
@@ -62,6 +63,14 @@ class Launcher {
     LAUNCHER_ACTR_TRIG_NUM, /* 总共的动作器数量 */
   };
 
+  enum {
+    LAUNCHER_MOTOR_FRIC_OFFSET = 0, /* 摩擦轮电机在motor_中的起始索引 */
+    LAUNCHER_MOTOR_TRIG_OFFSET =
+        static_cast<int>(LAUNCHER_ACTR_FRIC_NUM), /* 拨弹电机的起始索引 */
+    LAUNCHER_MOTOR_NUM = LAUNCHER_MOTOR_TRIG_OFFSET +
+                         static_cast<int>(LAUNCHER_ACTR_TRIG_NUM), /* 电机数量 */
+  };
+
   enum {
     LAUNCHER_CTRL_FRIC1_SPEED_IDX = 0, /* 摩擦轮1控制的速度环控制器的索引值 */
     LAUNCHER_CTRL_FRIC2_SPEED_IDX, /* 摩擦轮2控制的速度环控制器的索引值 */
@@ -175,8 +184,8 @@ class Launcher {
   std::array<Component::PosActuator *, LAUNCHER_ACTR_TRIG_NUM> trig_actuator_;
   std::array<Component::SpeedActuator *, LAUNCHER_ACTR_FRIC_NUM> fric_actuator_;
 
-  std::array<Device::RMMotor *, LAUNCHER_ACTR_TRIG_NUM> trig_motor_;
-  std::array<Device::RMMotor *, LAUNCHER_ACTR_FRIC_NUM> fric_motor_;
+  /* 摩擦轮在前，拨弹电机在后 */
+  Device::MotorBank<Device::RMMotor, LAUNCHER_MOTOR_NUM> motor_;
 
   RefForLauncher ref_;
 
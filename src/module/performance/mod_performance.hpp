@@ -1,3 +1,7 @@
+#if defined(__linux__)
+#include <semaphore.h>
+#endif
+
 #include "bsp_time.h"
 #include "module.hpp"
 
@@ -12,6 +16,35 @@ class Performance {
 
   static uint8_t static_mem_[64];
 
+  template <System::QueueMode Mode>
+  static void QueueTest(const char* name) {
+    static System::Queue<uint32_t, Mode> queue(16);
+    uint32_t data = 0;
+
+    auto time = bsp_time_get();
+    for (uint32_t i = 0; i < 1000000; i++) {
+      queue.Send(i);
+      queue.Receive(data);
+    }
+    time = bsp_time_get() - time;
+
+    printf("\t%s send and receive millon times\r\n", name);
+    printf("\t\t%f nanoseconds per session\r\n",
+           static_cast<float>(time) / 1000.0f);
+
+    time = bsp_time_get();
+    for (uint32_t i = 0; i < 1000000; i++) {
+      queue.Overwrite(i);
+    }
+    time = bsp_time_get() - time;
+
+    printf("\t%s overwrite millon times\r\n", name);
+    printf("\t\t%f nanoseconds per session\r\n",
+           static_cast<float>(time) / 1000.0f);
+
+    queue.Reset();
+  }
+
   static int Test(Performance* perf, int argc, char** argv) {
     XB_UNUSED(argc);
     XB_UNUSED(argv);
@@ -48,8 +81,8 @@ class Performance {
 
       printf("\tPost millon times\r\n");
 
-      printf("\t\t%f microseconds per session\r\n",
-             static_cast<float>(time) / 1000.0f / 1000000.0f);
+      printf("\t\t%f nanoseconds per session\r\n",
+             static_cast<float>(time) / 1000.0f);
 
       perf->sem_2_.Post();
 
@@ -75,14 +108,14 @@ class Performance {
         perf->sem_2_.Post();
       }
 
-      System::Thread::Sleep(200);
-
       time = bsp_time_get() - time;
 
-      printf("\tWait and post millon times\r\n");
+      System::Thread::Sleep(200);
+
+      printf("\tWait and post between threads 500000 times\r\n");
 
-      printf("\t\t%f microseconds per session\r\n",
-             static_cast<float>(time) / 1000.0f / 1000000.0f);
+      printf("\t\t%f nanoseconds per session\r\n",
+             static_cast<float>(time) / 500.0f);
 
       /* post */
       perf->sem_2_.Wait();
@@ -96,16 +129,56 @@ class Performance {
 
       printf("\tWait millon times\r\n");
 
-      printf("\t\t%f microseconds per session\r\n",
-             static_cast<float>(time) / 1000.0f / 1000000.0f);
+      printf("\t\t%f nanoseconds per session\r\n",
+             static_cast<float>(time) / 1000.0f);
 
       perf->sem_2_.Wait(UINT32_MAX);
 
+      /* 同一线程内post和wait，不会阻塞 */
+      System::Semaphore sem(0);
+      time = bsp_time_get();
+      for (int i = 0; i < 1000000; i++) {
+        sem.Post();
+        sem.Wait(0);
+      }
+      time = bsp_time_get() - time;
+
+      printf("\tPost and wait in one thread millon times\r\n");
+
+      printf("\t\t%f nanoseconds per session\r\n",
+             static_cast<float>(time) / 1000.0f);
+
+#if defined(__linux__)
+      /* POSIX信号量作为对照 */
+      sem_t posix_sem;
+      sem_init(&posix_sem, 0, 0);
+      time = bsp_time_get();
+      for (int i = 0; i < 1000000; i++) {
+        sem_post(&posix_sem);
+        sem_trywait(&posix_sem);
+      }
+      time = bsp_time_get() - time;
+      sem_destroy(&posix_sem);
+
+      printf("\tPOSIX sem_post and sem_trywait millon times\r\n");
+
+      printf("\t\t%f nanoseconds per session\r\n",
+             static_cast<float>(time) / 1000.0f);
+#endif
+
       printf("*** Semaphore Test End ***\r\n\n");
     }
 
     perf->thread_test.Delete();
 
+    printf("*** Queue Test Start ***\r\n");
+    QueueTest<System::QUEUE_LOCKED>("Locked");
+    QueueTest<System::QUEUE_SPSC>("SPSC");
+#if QUEUE_ATOMIC_RMW
+    QueueTest<System::QUEUE_MPSC>("MPSC");
+#endif
+    printf("*** Queue Test End ***\r\n\n");
+
     printf("*** Memory Test Start ***\r\n");
 
     void* mem = malloc(1024);
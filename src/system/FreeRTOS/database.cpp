@@ -1,7 +1,10 @@
 #include <atomic>
 #include <cstring>
 #include <database.hpp>
+#include <mutex.hpp>
+#include <semaphore.hpp>
 #include <term.hpp>
+#include <thread.hpp>
 
 #include "ms.h"
 
@@ -11,6 +14,129 @@ static uint8_t sn_buff[33];
 
 static ms_item_t sn_tools;
 
+Database::Entry* Database::list_ = NULL;
+
+static Semaphore* flush_sem;
+static Mutex* flush_mutex;
+static Thread flush_thread;
+
+/* 磨损统计 */
+static uint32_t total_set = 0;      /* Set()调用次数 */
+static uint32_t total_write = 0;    /* 实际写入flash次数 */
+static uint32_t total_skip = 0;     /* 内容未改变而跳过的写入次数 */
+static uint32_t total_coalesce = 0; /* 被合并的Set()次数 */
+
+static uint32_t fnv1a(const uint8_t* buff, uint32_t len) {
+  uint32_t hash = 2166136261u;
+  while (len--) {
+    hash ^= *buff++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void Database::Register(Entry* entry, const char* name, void* data,
+                        uint32_t size, bool dirty) {
+  entry->name = name;
+  entry->data = static_cast<uint8_t*>(data);
+  entry->size = size;
+  entry->hash = dirty ? ~fnv1a(entry->data, size) : fnv1a(entry->data, size);
+  entry->set_count = 0;
+  entry->write_count = 0;
+  entry->dirty = dirty;
+
+  vTaskSuspendAll();
+  entry->next = list_;
+  list_ = entry;
+  xTaskResumeAll();
+
+  if (dirty) {
+    flush_sem->Post();
+  }
+}
+
+void Database::MarkDirty(Entry* entry) {
+  bool post = false;
+
+  vTaskSuspendAll();
+  entry->set_count++;
+  total_set++;
+  if (entry->dirty) {
+    total_coalesce++;
+  } else {
+    entry->dirty = true;
+    post = true;
+  }
+  xTaskResumeAll();
+
+  if (post) {
+    flush_sem->Post();
+  }
+}
+
+void Database::Sync() {
+  flush_mutex->Lock();
+
+  for (Entry* entry = list_; entry; entry = entry->next) {
+    /* 先清除标记，写入期间的Set()会在下一轮写回 */
+    vTaskSuspendAll();
+    bool dirty = entry->dirty;
+    entry->dirty = false;
+    xTaskResumeAll();
+
+    if (!dirty) {
+      continue;
+    }
+
+    uint32_t hash = fnv1a(entry->data, entry->size);
+    if (hash == entry->hash) {
+      total_skip++;
+      continue;
+    }
+
+    bsp_flash_set_blog(entry->name, entry->data, entry->size);
+    entry->hash = hash;
+    entry->write_count++;
+    total_write++;
+  }
+
+  flush_mutex->Unlock();
+}
+
+int Database::ShowCMD(void* arg, int argc, char** argv) {
+  XB_UNUSED(arg);
+
+  if (argc == 2 && strcmp(argv[1], "sync") == 0) {
+    Sync();
+    printf("Database synced.\r\n");
+    return 0;
+  }
+
+  if (argc != 1) {
+    printf("[sync] 立即写入flash\r\n");
+    return 0;
+  }
+
+  printf("%-20s %6s %8s %8s %6s\r\n", "key", "size", "set", "write",
+         "dirty");
+
+  for (Entry* entry = list_; entry; entry = entry->next) {
+    printf("%-20s %6u %8u %8u %6s\r\n", entry->name,
+           static_cast<unsigned int>(entry->size),
+           static_cast<unsigned int>(entry->set_count),
+           static_cast<unsigned int>(entry->write_count),
+           entry->dirty ? "yes" : "no");
+  }
+
+  printf("set:%u write:%u skip:%u coalesce:%u\r\n",
+         static_cast<unsigned int>(total_set),
+         static_cast<unsigned int>(total_write),
+         static_cast<unsigned int>(total_skip),
+         static_cast<unsigned int>(total_coalesce));
+
+  return 0;
+}
+
 Database::Database() {
   bsp_flash_init();
 
@@ -63,6 +189,24 @@ Database::Database() {
     return 0;
   };
 
+  auto flush_thread_fn = [](void* arg) {
+    XB_UNUSED(arg);
+
+    while (1) {
+      flush_sem->Wait(UINT32_MAX);
+      /* 合并写回窗口内的所有修改 */
+      Thread::Sleep(DATABASE_WRITE_BACK_MS);
+      Database::Sync();
+    }
+  };
+
+  flush_sem = new Semaphore(0);
+  flush_mutex = new Mutex();
+
+  flush_thread.Create(flush_thread_fn, static_cast<void*>(NULL),
+                      "database_flush", FREERTOS_DATABASE_TASK_STACK_DEPTH,
+                      Thread::LOW);
+
   ms_file_init(&sn_tools, "sn_tools", sn_cmd_fn, sn_buff, sizeof(sn_buff),
                false);
   ms_cmd_add(&sn_tools);
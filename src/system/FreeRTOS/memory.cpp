@@ -1,9 +1,131 @@
+#include <cstdio>
 #include <memory.hpp>
 
+#include "bsp_def.h"
+#include "memory_pool.hpp"
 #include "portable.h"
+#include "task.h"
 
 using namespace System;
 
-void* operator new(std::size_t size) { return pvPortMalloc(size); }
+#if MEMORY_POOL_CCMRAM
+#define MEMORY_POOL_SECTION __attribute__((section(".ccmram")))
+#else
+#define MEMORY_POOL_SECTION
+#endif
 
-void operator delete(void* ptr) noexcept { vPortFree(ptr); }
+/* 块数量为0时保留1字节，避免零长度数组 */
+#define MEMORY_POOL_BUFF_SIZE(_size, _num) ((_num) ? (_size) * (_num) : 1)
+
+alignas(8) static uint8_t pool_16_buff[MEMORY_POOL_BUFF_SIZE(
+    16, MEMORY_POOL_NUM_16)] MEMORY_POOL_SECTION;
+alignas(8) static uint8_t pool_32_buff[MEMORY_POOL_BUFF_SIZE(
+    32, MEMORY_POOL_NUM_32)] MEMORY_POOL_SECTION;
+alignas(8) static uint8_t pool_64_buff[MEMORY_POOL_BUFF_SIZE(
+    64, MEMORY_POOL_NUM_64)] MEMORY_POOL_SECTION;
+alignas(8) static uint8_t pool_128_buff[MEMORY_POOL_BUFF_SIZE(
+    128, MEMORY_POOL_NUM_128)] MEMORY_POOL_SECTION;
+alignas(8) static uint8_t pool_256_buff[MEMORY_POOL_BUFF_SIZE(
+    256, MEMORY_POOL_NUM_256)] MEMORY_POOL_SECTION;
+
+/* 按块大小升序排列 */
+static MemoryPool pools[] = {
+    MemoryPool(pool_16_buff, 16, MEMORY_POOL_NUM_16),
+    MemoryPool(pool_32_buff, 32, MEMORY_POOL_NUM_32),
+    MemoryPool(pool_64_buff, 64, MEMORY_POOL_NUM_64),
+    MemoryPool(pool_128_buff, 128, MEMORY_POOL_NUM_128),
+    MemoryPool(pool_256_buff, 256, MEMORY_POOL_NUM_256),
+};
+
+static bool frozen = false;
+static uint32_t frozen_alloc_count = 0;
+
+void* operator new(std::size_t size) { return Memory::Malloc(size); }
+
+void operator delete(void* ptr) noexcept { Memory::Free(ptr); }
+
+void operator delete(void* ptr, std::size_t size) noexcept {
+  XB_UNUSED(size);
+  Memory::Free(ptr);
+}
+
+extern "C" void* system_memory_malloc(size_t size) {
+  return Memory::Malloc(size);
+}
+
+extern "C" void system_memory_free(void* block) { Memory::Free(block); }
+
+void* Memory::Malloc(size_t size) {
+  if (frozen) {
+    frozen_alloc_count++;
+    XB_ASSERT(false);
+  }
+
+  /* 与heap_4一致，挂起调度器而不关中断，调度器启动前也可以调用 */
+  vTaskSuspendAll();
+  for (auto& pool : pools) {
+    if (size <= pool.BlockSize()) {
+      void* block = pool.Alloc();
+      if (block != NULL) {
+        xTaskResumeAll();
+        return block;
+      }
+      break;
+    }
+  }
+  xTaskResumeAll();
+
+  return pvPortMalloc(size);
+}
+
+void Memory::Free(void* block) {
+  if (block == NULL) {
+    return;
+  }
+
+  for (auto& pool : pools) {
+    if (pool.Contains(block)) {
+      vTaskSuspendAll();
+      pool.Free(block);
+      xTaskResumeAll();
+      return;
+    }
+  }
+
+  vPortFree(block);
+}
+
+void Memory::Freeze() { frozen = true; }
+
+bool Memory::Frozen() { return frozen; }
+
+int Memory::ShowCMD(void* arg, int argc, char** argv) {
+  XB_UNUSED(arg);
+  XB_UNUSED(argv);
+
+  if (argc != 1) {
+    printf("显示内存池和堆的使用情况\r\n");
+    return 0;
+  }
+
+  printf("%-8s %8s %8s %8s %8s\r\n", "block", "total", "used", "max used",
+         "failed");
+
+  for (auto& pool : pools) {
+    printf("%-8u %8u %8u %8u %8u\r\n",
+           static_cast<unsigned int>(pool.BlockSize()),
+           static_cast<unsigned int>(pool.BlockNum()),
+           static_cast<unsigned int>(pool.Used()),
+           static_cast<unsigned int>(pool.MaxUsed()),
+           static_cast<unsigned int>(pool.Failed()));
+  }
+
+  printf("heap free:%u min free:%u\r\n",
+         static_cast<unsigned int>(xPortGetFreeHeapSize()),
+         static_cast<unsigned int>(xPortGetMinimumEverFreeHeapSize()));
+
+  printf("frozen:%s alloc after freeze:%u\r\n", frozen ? "yes" : "no",
+         static_cast<unsigned int>(frozen_alloc_count));
+
+  return 0;
+}
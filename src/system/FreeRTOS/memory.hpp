@@ -6,10 +6,19 @@
 
 void* operator new(std::size_t size);
 void operator delete(void* ptr) noexcept;
+
 namespace System {
+/* 不大于256字节的分配优先使用固定块内存池，池满或更大的分配使用FreeRTOS堆 */
 class Memory {
  public:
-  static void* Malloc(size_t size) { return pvPortMalloc(size); }
-  static void Free(void* block) { vPortFree(block); }
+  static void* Malloc(size_t size);
+  static void Free(void* block);
+
+  /* 冻结后任何堆分配都会触发断言，用于保证控制循环中没有内存分配 */
+  static void Freeze();
+
+  static bool Frozen();
+
+  static int ShowCMD(void* arg, int argc, char** argv);
 };
 }  // namespace System
@@ -8,12 +8,14 @@
 #include "FreeRTOS.h"
 #include "bsp_sys.h"
 #include "bsp_time.h"
+#include "lockfree_queue.hpp"
 #include "om.hpp"
 #include "projdefs.h"
 #include "task.h"
 
 namespace System {
-template <typename Data>
+/* 内核队列本身可以在中断中使用，Mode只用于和其他系统保持接口一致 */
+template <typename Data, QueueMode Mode = QUEUE_LOCKED>
 class Queue {
  public:
   Queue(uint16_t length) : queue_(xQueueCreate(length, sizeof(Data))) {}
@@ -21,11 +21,18 @@ void Start(RobotParam... param) {
     new (database) Database();
     Timer* timer = static_cast<Timer*>(pvPortMalloc(sizeof(Timer)));
     new (timer) Timer();
+    new Term::Command<Timer*>(timer, Timer::ShowCMD, "timer");
+    new Term::Command<void*>(NULL, Memory::ShowCMD, "memory");
+    new Term::Command<void*>(NULL, Database::ShowCMD, "db");
 
     static auto xrobot_debug_handle = new RobotType(param...);
 
     XB_UNUSED(xrobot_debug_handle);
 
+#if MEMORY_FREEZE_AFTER_INIT
+    Memory::Freeze();
+#endif
+
     while (1) {
       System::Thread::Sleep(UINT32_MAX);
     }
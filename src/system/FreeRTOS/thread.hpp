@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <memory.hpp>
 #include <string>
 
 #include "FreeRTOS.h"
@@ -22,7 +23,7 @@ class Thread {
     (void)static_cast<void (*)(ArgType)>(fun);
 
     TypeErasure<void, ArgType>* type = static_cast<TypeErasure<void, ArgType>*>(
-        pvPortMalloc(sizeof(TypeErasure<void, ArgType>)));
+        System::Memory::Malloc(sizeof(TypeErasure<void, ArgType>)));
 
     *type = TypeErasure<void, ArgType>(fun, arg);
 
@@ -54,14 +55,89 @@ class Thread {
     }
   }
 
+  /* 睡眠至少microseconds，唤醒时间向上取整到tick边界 */
+  static void SleepMicroseconds(uint32_t microseconds) {
+    if (microseconds == 0) {
+      return;
+    }
+
+    /* 当前tick已经过去的部分未知，从下一个tick边界开始计 */
+    DelayUntilUs((TickCount64() + 1) * TICK_US + microseconds);
+  }
+
   void SleepUntil(uint32_t microseconds, uint32_t& last_wakeup_time) {
     vTaskDelayUntil(&last_wakeup_time, microseconds);
   }
 
+  /* 微秒级周期延时，last_wakeup_time可以用bsp_time_get_us()初始化，
+   * 之后按64位扩展的tick计数推进，不随bsp_time_get_us()或tick计数回绕。
+   * 截止时间按微秒累加，相位不随调用时刻漂移；没有比tick更细的唤醒源，
+   * 实际在截止时间所在tick的下一个边界唤醒，周期小于一个tick时同一tick内
+   * 的几次调用直接返回，平均频率不变，不占用CPU轮询。
+   * 错过截止时间时跳过已错过的周期并返回false */
+  bool SleepUntilMicroseconds(uint32_t period, uint64_t& last_wakeup_time) {
+    uint64_t now = TickCount64() * TICK_US;
+    uint64_t target = last_wakeup_time + period;
+
+    if (target <= now) {
+      last_wakeup_time = target;
+      if (now - target < TICK_US) {
+        /* 截止时间在刚过去的tick内，是按tick唤醒的正常结果 */
+        return true;
+      }
+      if (period != 0 && now - target >= period) {
+        last_wakeup_time = now - (now - target) % period;
+      }
+      return period == 0;
+    }
+
+    if (target - now > period + TICK_US) {
+      /* last_wakeup_time不是由本时钟得到，重新对齐 */
+      target = now + period;
+    }
+
+    DelayUntilUs(target);
+
+    last_wakeup_time = target;
+
+    return true;
+  }
+
   void Delete() { vTaskDelete(this->handle_); }
 
   static void Yield() { taskYIELD(); }
 
   TaskHandle_t handle_ = NULL;
+
+ private:
+  static constexpr uint32_t TICK_US = 1000000 / configTICK_RATE_HZ;
+
+  /* 当前tick计数，按内核记录的溢出次数扩展为64位 */
+  static uint64_t TickCount64() {
+    TimeOut_t time;
+    vTaskSetTimeOutState(&time);
+
+    return (static_cast<uint64_t>(time.xOverflowCount)
+            << (sizeof(TickType_t) * 8)) |
+           time.xTimeOnEntering;
+  }
+
+  /* 截止时间以64位tick时钟为基准，换算为绝对tick后由vTaskDelayUntil等待 */
+  static void DelayUntilUs(uint64_t target) {
+    uint64_t wakeup = (target + TICK_US - 1) / TICK_US;
+    uint64_t now = TickCount64();
+
+    if (wakeup <= now) {
+      return;
+    }
+
+    while (wakeup - now > portMAX_DELAY / 2) {
+      vTaskDelay(portMAX_DELAY / 2);
+      now = TickCount64();
+    }
+
+    TickType_t last = static_cast<TickType_t>(now);
+    vTaskDelayUntil(&last, static_cast<TickType_t>(wakeup - now));
+  }
 };
 }  // namespace System
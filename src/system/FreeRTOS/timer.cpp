@@ -6,15 +6,37 @@ using namespace System;
 
 Timer* Timer::self_ = NULL;
 
-Timer::Timer() {
+/* 没有定时器到期时的最长睡眠时间，保证时钟扩展不会漏掉回绕 */
+static const uint64_t TIMER_MAX_SLEEP_US = 1000000;
+
+Timer::Timer() : last_raw_time_(static_cast<uint32_t>(bsp_time_get_us())) {
   self_ = this;
 
   auto thread_fn = [](void* arg) {
     XB_UNUSED(arg);
-    uint32_t last_online_time = bsp_time_get_ms();
+    Timer* self = Timer::self_;
+
     while (1) {
-      Timer::self_->list_.Foreach(Timer::Refresh, NULL);
-      Timer::self_->thread_.SleepUntil(1, last_online_time);
+      self->mutex_.Lock();
+
+      uint64_t now = self->Now();
+      self->wheel_.Advance(now, [&](TimerWheel::Node* node) {
+        self->Expire(node, now);
+      });
+
+      now = self->Now();
+      uint64_t next = self->wheel_.Next();
+      uint64_t delay = next > now ? next - now : 0;
+      if (delay > TIMER_MAX_SLEEP_US) {
+        delay = TIMER_MAX_SLEEP_US;
+      }
+
+      self->mutex_.Unlock();
+
+      /* 以系统tick为最小睡眠单位，不足一个tick的定时器在下一个tick执行 */
+      if (delay != 0) {
+        self->wakeup_.Wait(static_cast<uint32_t>((delay + 999) / 1000));
+      }
     }
   };
 
@@ -22,18 +44,131 @@ Timer::Timer() {
                        FREERTOS_TIMER_TASK_STACK_DEPTH, Thread::HIGH);
 }
 
-bool Timer::Refresh(ControlBlock& block, void* arg) {
-  XB_UNUSED(arg);
+uint64_t Timer::Now() {
+  uint32_t raw = static_cast<uint32_t>(bsp_time_get_us());
+  time_ += static_cast<uint32_t>(raw - last_raw_time_);
+  last_raw_time_ = raw;
+  return time_;
+}
+
+void Timer::Arm(ControlBlock* block) {
+  block->expires_ = Now() + block->cycle;
+  wheel_.Add(block);
+  wakeup_.Post();
+}
+
+void Timer::Add(ControlBlock* block) {
+  mutex_.Lock();
+  block->next = list_;
+  list_ = block;
+  block->running = true;
+  Arm(block);
+  mutex_.Unlock();
+}
+
+void Timer::Expire(TimerWheel::Node* node, uint64_t now) {
+  ControlBlock* block = static_cast<ControlBlock*>(node);
+
+  uint64_t delay = now - block->expires_;
+  if (delay > block->max_delay) {
+    block->max_delay = static_cast<uint32_t>(delay);
+  }
+
+  block->count++;
+
+  if (block->mode == PERIODIC) {
+    /* 按原相位重新插入，错过的周期计入overrun */
+    uint64_t missed = delay / block->cycle;
+    block->overrun += static_cast<uint32_t>(missed);
+    block->expires_ += (missed + 1) * block->cycle;
+    wheel_.Add(block);
+  } else {
+    block->running = false;
+  }
+
+  auto fun = block->fun;
+  auto type = block->type;
+
+  /* 回调中允许操作定时器 */
+  mutex_.Unlock();
+  fun(type);
+  mutex_.Lock();
+}
+
+void Timer::Delete(TimerHandle& handle) {
+  self_->mutex_.Lock();
+  self_->wheel_.Remove(handle);
+  for (ControlBlock** pos = &self_->list_; *pos; pos = &(*pos)->next) {
+    if (*pos == handle) {
+      *pos = handle->next;
+      break;
+    }
+  }
+  self_->mutex_.Unlock();
+  delete (handle);
+}
 
-  if (!block.running) {
-    return true;
+void Timer::Start(TimerHandle& handle) {
+  self_->mutex_.Lock();
+  if (!handle->running) {
+    handle->running = true;
+    self_->Arm(handle);
   }
+  self_->mutex_.Unlock();
+}
+
+void Timer::Stop(TimerHandle& handle) {
+  self_->mutex_.Lock();
+  handle->running = false;
+  self_->wheel_.Remove(handle);
+  self_->mutex_.Unlock();
+}
+
+void Timer::SetCycle(TimerHandle& timer, uint32_t cycle) {
+  SetCycleMicroseconds(timer, (cycle ? cycle : 1) * 1000);
+}
+
+void Timer::SetCycleMicroseconds(TimerHandle& timer, uint32_t cycle) {
+  self_->mutex_.Lock();
+  timer->cycle = cycle ? cycle : 1;
+  if (timer->Linked()) {
+    self_->wheel_.Remove(timer);
+    self_->Arm(timer);
+  }
+  self_->mutex_.Unlock();
+}
+
+int Timer::ShowCMD(Timer* timer, int argc, char** argv) {
+  if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+    timer->mutex_.Lock();
+    for (ControlBlock* pos = timer->list_; pos; pos = pos->next) {
+      pos->count = 0;
+      pos->overrun = 0;
+      pos->max_delay = 0;
+    }
+    timer->mutex_.Unlock();
+    return 0;
+  }
+
+  if (argc != 1) {
+    printf("[reset] 清空统计数据\r\n");
+    return 0;
+  }
+
+  printf("%-16s %-8s %12s %10s %10s %14s\r\n", "name", "state", "cycle(us)",
+         "count", "overrun", "max delay(us)");
 
-  block.count++;
-  if (block.cycle <= block.count) {
-    block.count = 0;
-    block.fun(block.type);
+  timer->mutex_.Lock();
+  for (ControlBlock* pos = timer->list_; pos; pos = pos->next) {
+    printf("%-16s %-8s %12u %10u %10u %14u\r\n", pos->name,
+           pos->running ? (pos->mode == PERIODIC ? "periodic" : "oneshot")
+                        : "stop",
+           static_cast<unsigned int>(pos->cycle),
+           static_cast<unsigned int>(pos->count),
+           static_cast<unsigned int>(pos->overrun),
+           static_cast<unsigned int>(pos->max_delay));
   }
+  timer->mutex_.Unlock();
 
-  return true;
+  return 0;
 }
@@ -1,20 +1,298 @@
 #include <poll.h>
+#include <pthread.h>
 #include <stdint.h>
+#include <sys/mman.h>
 
 #include <array>
 #include <database.hpp>
+#include <semaphore.hpp>
 #include <term.hpp>
+#include <thread.hpp>
 
 #include "ms.h"
 
 using namespace System;
 
+#define DATABASE_MAGIC (0x42445258) /* "XRDB" */
+#define DATABASE_FILE_NAME "database.bin"
+#define DATABASE_ALIGN(_size) (((_size) + 7) & ~7U)
+
+/* 数据区之前的校验信息，crc覆盖从magic开始到数据区末尾 */
+typedef struct {
+  uint32_t crc;
+  uint32_t magic;
+  uint32_t seq;
+  uint32_t used;
+} BankHeader;
+
+/* 记录头后依次为名称(含结束符)和数据，均按8字节对齐 */
+typedef struct {
+  uint32_t size;
+  uint16_t name_len;
+  uint16_t deleted;
+} RecordHeader;
+
 static ms_item_t sn_tools;
 
 std::string Database::path_(std::string(getenv("HOME")) + "/.rm_database/");
 
 Database::Key<std::array<uint8_t, 32>> *sn;
 
+static pthread_mutex_t image_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t commit_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static System::Semaphore commit_sem(0);
+static System::Thread commit_thread;
+
+static uint8_t *map = NULL;   /* 文件映射，包含两个bank */
+static uint8_t *image = NULL; /* 最新数据的内存映像，与bank格式相同 */
+static uint32_t bank_size = 0;
+static uint32_t active_bank = 0;
+static bool dirty = false;
+
+static uint32_t crc32(const uint8_t *buff, uint32_t len) {
+  uint32_t crc = 0xffffffff;
+  while (len--) {
+    crc ^= *buff++;
+    for (int i = 0; i < 8; i++) {
+      crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static bool bank_valid(const uint8_t *bank, uint32_t size) {
+  const BankHeader *header = reinterpret_cast<const BankHeader *>(bank);
+
+  if (header->magic != DATABASE_MAGIC ||
+      header->used > size - sizeof(BankHeader)) {
+    return false;
+  }
+
+  return crc32(bank + sizeof(header->crc),
+               sizeof(BankHeader) - sizeof(header->crc) + header->used) ==
+         header->crc;
+}
+
+/* 从旧文件中选出序号最大的有效bank载入映像，返回是否需要重新提交 */
+static bool load_banks(const uint8_t *file, uint32_t old_bank_size) {
+  int select = -1;
+  uint32_t select_seq = 0;
+
+  for (int i = 0; i < 2; i++) {
+    const uint8_t *bank = file + i * old_bank_size;
+    if (!bank_valid(bank, old_bank_size)) {
+      continue;
+    }
+
+    uint32_t seq = reinterpret_cast<const BankHeader *>(bank)->seq;
+    if (select < 0 || static_cast<int32_t>(seq - select_seq) > 0) {
+      select = i;
+      select_seq = seq;
+    }
+  }
+
+  if (select < 0) {
+    return true;
+  }
+
+  const uint8_t *bank = file + select * old_bank_size;
+  uint32_t len =
+      sizeof(BankHeader) + reinterpret_cast<const BankHeader *>(bank)->used;
+
+  if (len > bank_size) {
+    printf("Database: data is larger than LINUX_DATABASE_SIZE, dropped.\r\n");
+    return true;
+  }
+
+  memcpy(image, bank, len);
+  active_bank = select;
+
+  return old_bank_size != bank_size;
+}
+
+static void database_open() {
+  if (image != NULL) {
+    return;
+  }
+
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  bank_size = (LINUX_DATABASE_SIZE * 1024 + page - 1) / page * page;
+
+  image = static_cast<uint8_t *>(calloc(1, bank_size));
+  BankHeader *header = reinterpret_cast<BankHeader *>(image);
+  header->magic = DATABASE_MAGIC;
+
+  mkdir(Database::path_.c_str(), S_IRWXU | S_IRWXG | S_IRWXO);
+
+  int fd = open((Database::path_ + DATABASE_FILE_NAME).c_str(),
+                O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    /* 无法持久化时仍可在内存中读写 */
+    printf("Database: can not open %s.\r\n",
+           (Database::path_ + DATABASE_FILE_NAME).c_str());
+    return;
+  }
+
+  struct stat st;
+  fstat(fd, &st);
+
+  bool need_commit = true;
+
+  if (st.st_size >= static_cast<off_t>(2 * sizeof(BankHeader))) {
+    void *old = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (old != MAP_FAILED) {
+      need_commit =
+          load_banks(static_cast<uint8_t *>(old),
+                     static_cast<uint32_t>(st.st_size / 2) & ~7U);
+      munmap(old, st.st_size);
+    }
+  }
+
+  if (st.st_size != static_cast<off_t>(2 * bank_size)) {
+    int ans = ftruncate(fd, 2 * bank_size);
+    XB_ASSERT(ans == 0);
+    XB_UNUSED(ans);
+  }
+
+  void *addr =
+      mmap(NULL, 2 * bank_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  XB_ASSERT(addr != MAP_FAILED);
+  if (addr != MAP_FAILED) {
+    map = static_cast<uint8_t *>(addr);
+  }
+
+  close(fd);
+
+  if (need_commit && !dirty) {
+    dirty = true;
+    commit_sem.Post();
+  }
+}
+
+uint32_t Database::Register(const char *name, void *data, uint32_t size) {
+  pthread_mutex_lock(&image_mutex);
+
+  database_open();
+
+  BankHeader *header = reinterpret_cast<BankHeader *>(image);
+  uint32_t name_len = strlen(name) + 1;
+  uint32_t offset = sizeof(BankHeader);
+  uint32_t end = sizeof(BankHeader) + header->used;
+
+  while (offset < end) {
+    RecordHeader *record = reinterpret_cast<RecordHeader *>(image + offset);
+    uint32_t data_offset =
+        offset + sizeof(RecordHeader) + DATABASE_ALIGN(record->name_len);
+
+    if (!record->deleted && record->name_len == name_len &&
+        strcmp(reinterpret_cast<char *>(record + 1), name) == 0) {
+      if (record->size == size) {
+        memcpy(data, image + data_offset, size);
+        pthread_mutex_unlock(&image_mutex);
+        return data_offset;
+      }
+
+      /* 数据类型改变，旧记录作废 */
+      record->deleted = 1;
+    }
+
+    offset = data_offset + DATABASE_ALIGN(record->size);
+  }
+
+  /* 兼容旧版本每个Key一个文件的格式 */
+  FILE *fd = fopen((path_ + name).c_str(), "r");
+  if (fd != NULL) {
+    static_cast<void>(fread(data, size, 1, fd));
+    static_cast<void>(fclose(fd));
+  }
+
+  uint32_t record_len =
+      sizeof(RecordHeader) + DATABASE_ALIGN(name_len) + DATABASE_ALIGN(size);
+
+  if (end + record_len > bank_size) {
+    printf("Database: no space for key %s.\r\n", name);
+    XB_ASSERT(false);
+    pthread_mutex_unlock(&image_mutex);
+    return UINT32_MAX;
+  }
+
+  RecordHeader *record = reinterpret_cast<RecordHeader *>(image + end);
+  record->size = size;
+  record->name_len = name_len;
+  record->deleted = 0;
+  memcpy(record + 1, name, name_len);
+
+  uint32_t data_offset =
+      end + sizeof(RecordHeader) + DATABASE_ALIGN(name_len);
+  memcpy(image + data_offset, data, size);
+
+  header->used += record_len;
+
+  if (!dirty) {
+    dirty = true;
+    commit_sem.Post();
+  }
+
+  pthread_mutex_unlock(&image_mutex);
+
+  return data_offset;
+}
+
+void Database::Read(uint32_t offset, void *data, uint32_t size) {
+  if (offset == UINT32_MAX) {
+    return;
+  }
+
+  pthread_mutex_lock(&image_mutex);
+  memcpy(data, image + offset, size);
+  pthread_mutex_unlock(&image_mutex);
+}
+
+void Database::Write(uint32_t offset, const void *data, uint32_t size) {
+  if (offset == UINT32_MAX) {
+    return;
+  }
+
+  pthread_mutex_lock(&image_mutex);
+  memcpy(image + offset, data, size);
+  if (!dirty) {
+    dirty = true;
+    commit_sem.Post();
+  }
+  pthread_mutex_unlock(&image_mutex);
+}
+
+void Database::Sync() {
+  pthread_mutex_lock(&commit_mutex);
+  pthread_mutex_lock(&image_mutex);
+
+  if (!dirty || map == NULL) {
+    pthread_mutex_unlock(&image_mutex);
+    pthread_mutex_unlock(&commit_mutex);
+    return;
+  }
+
+  /* 写入非活动bank，校验通过前旧bank始终有效 */
+  uint32_t target = active_bank ^ 1;
+  BankHeader *header = reinterpret_cast<BankHeader *>(image);
+  header->seq++;
+  header->crc = crc32(image + sizeof(header->crc),
+                      sizeof(BankHeader) - sizeof(header->crc) + header->used);
+
+  uint32_t len = sizeof(BankHeader) + header->used;
+  uint8_t *bank = map + target * bank_size;
+  memcpy(bank, image, len);
+  dirty = false;
+
+  pthread_mutex_unlock(&image_mutex);
+
+  msync(bank, len, MS_SYNC);
+  active_bank = target;
+
+  pthread_mutex_unlock(&commit_mutex);
+}
+
 Database::Database() {
   auto sn_cmd_fn = [](ms_item_t *item, int argc, char **argv) {
     OM_UNUSED(item);
@@ -48,6 +326,7 @@ Database::Database() {
 
         if (check_ok) {
           sn->Set();
+          Database::Sync();
           printf("SN:%.32s\r\n", sn->data_);
 
         } else {
@@ -61,9 +340,25 @@ Database::Database() {
     return 0;
   };
 
+  auto commit_thread_fn = [](void *arg) {
+    XB_UNUSED(arg);
+
+    while (1) {
+      commit_sem.Wait(UINT32_MAX);
+      /* 合并提交窗口内的所有修改 */
+      Thread::Sleep(LINUX_DATABASE_COMMIT_MS);
+      Database::Sync();
+    }
+  };
+
   poll(NULL, 0, 1);
 
-  mkdir(path_.c_str(), S_IRWXU | S_IRWXG | S_IRWXO);
+  pthread_mutex_lock(&image_mutex);
+  database_open();
+  pthread_mutex_unlock(&image_mutex);
+
+  commit_thread.Create(commit_thread_fn, static_cast<void *>(NULL),
+                       "database_commit", 256, Thread::LOW);
 
   sn = new Database::Key<std::array<uint8_t, 32>>("SN");
 
@@ -10,8 +10,12 @@
 #include <cstdlib>
 #include <cstring>
 #include <string>
+#include <type_traits>
 
 namespace System {
+/* 所有Key保存在同一个内存映射文件中，文件分为两个bank，
+ * 每次提交写入非活动bank并整体校验，掉电时总有一个完整的bank可用。
+ * Get()/Set()只访问内存，Set()后的修改在提交窗口内合并为一次msync。 */
 class Database {
  public:
   Database();
@@ -19,62 +23,48 @@ class Database {
   template <typename Data>
   class Key {
    public:
+    static_assert(std::is_trivially_copyable<Data>::value,
+                  "Database data must be trivially copyable");
+
     Key(const char* name) : name_(name) {
-      FILE* fd = NULL;
-      if (!access((path_ + name).c_str(), W_OK)) {
-        fd = fopen((path_ + name).c_str(), "r");
-        static_cast<void>(fread(&this->data_, sizeof(Data), 1, fd));
-        static_cast<void>(fclose(fd));
-      } else {
-        fd = fopen((path_ + name).c_str(), "w+");
-        memset(&this->data_, 0, sizeof(Data));
-        static_cast<void>(fwrite(&this->data_, sizeof(Data), 1, fd));
-        static_cast<void>(fclose(fd));
-      }
+      memset(&this->data_, 0, sizeof(Data));
+      offset_ = Database::Register(name, &this->data_, sizeof(Data));
     }
 
-    Key(const char* name, const Data& init_value) : name_(name) {
-      FILE* fd = NULL;
-      if (!access((path_ + name).c_str(), W_OK)) {
-        fd = fopen((path_ + name).c_str(), "r");
-        static_cast<void>(fread(&this->data_, sizeof(Data), 1, fd));
-        static_cast<void>(fclose(fd));
-      } else {
-        fd = fopen((path_ + name).c_str(), "w+");
-        this->data_ = init_value;
-        static_cast<void>(fwrite(&this->data_, sizeof(Data), 1, fd));
-        static_cast<void>(fclose(fd));
-      }
+    Key(const char* name, const Data& init_value)
+        : data_(init_value), name_(name) {
+      offset_ = Database::Register(name, &this->data_, sizeof(Data));
     }
 
-    void Set() {
-      FILE* fd = NULL;
-      fd = fopen((path_ + name_).c_str(), "w+");
-      static_cast<void>(fwrite(&this->data_, sizeof(Data), 1, fd));
-      static_cast<void>(fclose(fd));
-    }
+    void Set() { Database::Write(offset_, &this->data_, sizeof(Data)); }
 
     void Set(const Data& data) {
       this->data_ = data;
-      FILE* fd = NULL;
-      fd = fopen((path_ + name_).c_str(), "w+");
-      static_cast<void>(fwrite(&this->data_, sizeof(Data), 1, fd));
-      static_cast<void>(fclose(fd));
+      Set();
     }
 
-    void Get() {
-      FILE* fd = NULL;
-      fd = fopen((path_ + name_).c_str(), "r");
-      static_cast<void>(fread(&this->data_, sizeof(Data), 1, fd));
-      static_cast<void>(fclose(fd));
-    }
+    void Get() { Database::Read(offset_, &this->data_, sizeof(Data)); }
 
     operator Data() { return data_; }
 
     Data data_;
     const char* name_;
+
+   private:
+    uint32_t offset_;
   };
 
+  /* 立即提交所有修改并等待写入完成 */
+  static void Sync();
+
   static std::string path_;
+
+ private:
+  /* 查找或创建记录，已存在时将保存的值读到data，返回数据在映像中的偏移 */
+  static uint32_t Register(const char* name, void* data, uint32_t size);
+
+  static void Read(uint32_t offset, void* data, uint32_t size);
+
+  static void Write(uint32_t offset, const void* data, uint32_t size);
 };
 }  // namespace System
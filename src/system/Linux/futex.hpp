@@ -0,0 +1,44 @@
+#pragma once
+
+#include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+
+namespace System {
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futex word must be 32 bits");
+
+/* 计算CLOCK_MONOTONIC上timeout毫秒后的绝对时间，不受NTP和手动校时影响 */
+static inline void futex_deadline(struct timespec* ts, uint32_t timeout) {
+  clock_gettime(CLOCK_MONOTONIC, ts);
+  ts->tv_sec += static_cast<time_t>(timeout / 1000);
+  ts->tv_nsec += static_cast<long>(timeout % 1000) * 1000000L;
+  if (ts->tv_nsec >= 1000000000L) {
+    ts->tv_sec++;
+    ts->tv_nsec -= 1000000000L;
+  }
+}
+
+/* *addr等于expected时睡眠，deadline为CLOCK_MONOTONIC绝对时间，NULL表示永久等待。
+ * 返回0或errno(ETIMEDOUT/EAGAIN/EINTR) */
+static inline int futex_wait(std::atomic<uint32_t>* addr, uint32_t expected,
+                             const struct timespec* deadline) {
+  if (syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr),
+              FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG, expected, deadline, NULL,
+              FUTEX_BITSET_MATCH_ANY) == 0) {
+    return 0;
+  }
+  return errno;
+}
+
+static inline void futex_wake(std::atomic<uint32_t>* addr, int num) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr),
+          FUTEX_WAKE | FUTEX_PRIVATE_FLAG, num, NULL, NULL, 0);
+}
+}  // namespace System
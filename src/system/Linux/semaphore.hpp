@@ -1,45 +1,79 @@
 #pragma once
 
-#include <poll.h>
-#include <semaphore.h>
-
+#include <atomic>
 #include <cstdint>
 #include <cstdio>
+#include <futex.hpp>
 #include <thread.hpp>
 
 #include "bsp_time.h"
 
 namespace System {
+/* 基于futex的计数信号量，计数足够时只在用户态做一次CAS，
+ * 只有存在等待者时Post才进入内核。超时基于CLOCK_MONOTONIC */
 class Semaphore {
  public:
-  Semaphore(uint32_t init_count) { sem_init(&this->handle_, 0, init_count); }
-
-  ~Semaphore() { sem_destroy(&this->handle_); }
+  Semaphore(uint32_t init_count) : count_(init_count) {}
 
-  void Post() { sem_post(&this->handle_); }
+  void Post() {
+    count_.fetch_add(1, std::memory_order_seq_cst);
+    if (waiters_.load(std::memory_order_seq_cst) > 0) {
+      futex_wake(&count_, 1);
+    }
+  }
 
   bool Wait(uint32_t timeout = UINT32_MAX) {
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    uint32_t secs = timeout / 1000;
-    timeout = timeout % 1000;
-
-    uint32_t add = 0;
-    long raw_time = timeout * 1000U * 1000U + ts.tv_nsec;
-    add = raw_time / (1000U * 1000U * 1000U);
-    ts.tv_sec += (add + secs);
-    ts.tv_nsec = raw_time % (1000U * 1000U * 1000U);
-
-    return sem_timedwait(&handle_, &ts) == 0;
-  }
+    if (TryWait()) {
+      return true;
+    }
+
+    if (timeout == 0) {
+      return false;
+    }
+
+    struct timespec deadline;
+    if (timeout != UINT32_MAX) {
+      futex_deadline(&deadline, timeout);
+    }
+
+    bool ans = false;
 
-  uint32_t Value() {
-    int value = 0;
-    sem_getvalue(&handle_, &value);
-    return value;
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+
+    while (true) {
+      if (TryWait()) {
+        ans = true;
+        break;
+      }
+
+      if (futex_wait(&count_, 0, timeout == UINT32_MAX ? NULL : &deadline) ==
+          ETIMEDOUT) {
+        ans = TryWait();
+        break;
+      }
+    }
+
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+
+    return ans;
   }
 
+  uint32_t Value() { return count_.load(std::memory_order_relaxed); }
+
  private:
-  sem_t handle_;
+  bool TryWait() {
+    uint32_t count = count_.load(std::memory_order_relaxed);
+    while (count > 0) {
+      if (count_.compare_exchange_weak(count, count - 1,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::atomic<uint32_t> count_;
+  std::atomic<uint32_t> waiters_{0};
 };
 }  // namespace System
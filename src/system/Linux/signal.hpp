@@ -1,46 +1,74 @@
 #pragma once
 
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <unistd.h>
-
-#include <csignal>
+#include <atomic>
 #include <cstdint>
+#include <futex.hpp>
 #include <thread.hpp>
 
 #include "bsp_def.h"
 
 namespace System {
+/* 与FreeRTOS的任务通知一致，每个线程有32个通知位，重复触发会合并。
+ * 通知位已置位时Wait不进入内核，只有目标线程正在等待时Action才唤醒它 */
 class Signal {
  public:
   static bool Action(System::Thread& thread, int sig) {
-    sig += SIGRTMIN;
-    XB_ASSERT(sig >= SIGRTMIN && sig <= SIGRTMAX);
-    return pthread_kill(thread.handle_, sig) == 0;
+    XB_ASSERT(sig >= 0 && sig < 32);
+    XB_ASSERT(thread.notify_);
+
+    Thread::Notify* notify = thread.notify_;
+    notify->value.fetch_or(1U << sig, std::memory_order_seq_cst);
+    if (notify->waiting.load(std::memory_order_seq_cst)) {
+      futex_wake(&notify->value, 1);
+    }
+    return true;
   }
 
   static bool Wait(int sig, uint32_t timeout) {
-    sigset_t waitset, oldset;
-    sig += SIGRTMIN;
-    XB_ASSERT(sig >= SIGRTMIN && sig <= SIGRTMAX);
-
-    sigemptyset(&waitset);
-    sigaddset(&waitset, sig);
-    pthread_sigmask(SIG_BLOCK, &waitset, &oldset);
-
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    uint32_t secs = timeout / 1000;
-    timeout = timeout % 1000;
-
-    uint32_t add = 0;
-    long raw_time = timeout * 1000U * 1000U + ts.tv_nsec;
-    add = raw_time / (1000U * 1000U * 1000U);
-    ts.tv_sec += (add + secs);
-    ts.tv_nsec = raw_time % (1000U * 1000U * 1000U);
-    int res = sigtimedwait(&waitset, NULL, &ts);
-    pthread_sigmask(SIG_BLOCK, &oldset, NULL);
-    return res == sig;
+    XB_ASSERT(sig >= 0 && sig < 32);
+
+    const uint32_t SIG_BIT = 1U << sig;
+    Thread::Notify* notify = Thread::CurrentNotify();
+
+    if (Take(notify, SIG_BIT)) {
+      return true;
+    }
+
+    if (timeout == 0) {
+      return false;
+    }
+
+    struct timespec deadline;
+    if (timeout != UINT32_MAX) {
+      futex_deadline(&deadline, timeout);
+    }
+
+    bool ans = false;
+
+    notify->waiting.store(1, std::memory_order_seq_cst);
+
+    while (true) {
+      uint32_t value = notify->value.load(std::memory_order_seq_cst);
+      if (value & SIG_BIT) {
+        ans = Take(notify, SIG_BIT);
+        break;
+      }
+
+      if (futex_wait(&notify->value, value,
+                     timeout == UINT32_MAX ? NULL : &deadline) == ETIMEDOUT) {
+        ans = Take(notify, SIG_BIT);
+        break;
+      }
+    }
+
+    notify->waiting.store(0, std::memory_order_relaxed);
+
+    return ans;
+  }
+
+ private:
+  static bool Take(Thread::Notify* notify, uint32_t bit) {
+    return notify->value.fetch_and(~bit, std::memory_order_acquire) & bit;
   }
 };
 
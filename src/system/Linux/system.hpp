@@ -18,6 +18,7 @@ void Start(RobotParam... param) {
     new Term();
     new Database();
     new Timer();
+    new Term::Command<Timer*>(Timer::self_, Timer::ShowCMD, "timer");
 
     static auto xrobot_debug_handle = new RobotType(param...);
 
@@ -1,10 +1,11 @@
 
-#include <fcntl.h>
 #include <stdio.h>
-#include <termios.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <cstddef>
+#include <queue.hpp>
+#include <semaphore.hpp>
 #include <term.hpp>
 #include <thread.hpp>
 
@@ -16,30 +17,22 @@
 
 using namespace System;
 
-static System::Thread term_thread, term_udp_thread;
+static System::Thread term_thread;
 
 static bsp_udp_server_t term_udp_server;
 
 static ms_item_t power_ctrl;
 
-static int kbhit() {
-  struct termios oldt, newt;
-  int ch;
-  int oldf;
-  tcgetattr(STDIN_FILENO, &oldt);
-  newt = oldt;
-  newt.c_lflag &= ~(ICANON | ECHO);
-  tcsetattr(STDIN_FILENO, TCSANOW, &newt);
-  oldf = fcntl(STDIN_FILENO, F_GETFL, 0);
-  fcntl(STDIN_FILENO, F_SETFL, oldf | O_NONBLOCK);
-  ch = getchar();
-  tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
-  fcntl(STDIN_FILENO, F_SETFL, oldf);
-  if (ch != EOF) {
-    ungetc(ch, stdin);
-    return 1;
+/* 终端输入和UDP日志服务器共用一个事件循环，只在有数据时处理输入 */
+static hloop_t *term_loop;
+
+static void term_input_cb(hio_t *io, void *buf, int readbytes) {
+  XB_UNUSED(io);
+
+  const char *data = static_cast<const char *>(buf);
+  for (int i = 0; i < readbytes; i++) {
+    ms_input(data[i]);
   }
-  return 0;
 }
 
 int show_fun(const char *data, size_t len) {
@@ -50,15 +43,11 @@ int show_fun(const char *data, size_t len) {
   return 0;
 }
 
-static om_status_t print_log(om_msg_t *msg, void *arg) {
-  XB_UNUSED(arg);
-
-  static char time_print_buff[20];
-
-  om_log_t *log = static_cast<om_log_t *>(msg->buff);
+static void output_log(uint64_t time, const char *data) {
+  static char time_print_buff[24];
 
   (void)snprintf(time_print_buff, sizeof(time_print_buff), "%-.4f ",
-                 static_cast<float>(bsp_time_get()) / 1000000.0f);
+                 static_cast<double>(time) / 1000000.0);
 
 #ifdef TERM_LOG_UDP_SERVER
   bsp_udp_server_transmit(&term_udp_server,
@@ -66,14 +55,59 @@ static om_status_t print_log(om_msg_t *msg, void *arg) {
                           strlen(time_print_buff));
 
   bsp_udp_server_transmit(&term_udp_server,
-                          reinterpret_cast<const uint8_t *>(log->data),
-                          strlen(log->data));
+                          reinterpret_cast<const uint8_t *>(data),
+                          strlen(data));
 #endif
 
-  ms_printf_insert("%s%s", time_print_buff, log->data);
+  ms_printf_insert("%s%s", time_print_buff, data);
+}
+
+#if TERM_LOG_DEFERRED
+/* 日志发布时只记录原始时间戳和文本，格式化和终端/UDP输出由低优先级线程完成 */
+typedef struct {
+  uint64_t time;
+  char data[OM_LOG_MAX_LEN];
+} LogRecord;
+
+static System::Queue<LogRecord, QUEUE_MPSC> *log_queue;
+static System::Semaphore *log_sem;
+static System::Thread log_thread;
+static std::atomic<bool> log_pending(false);
+static std::atomic<uint32_t> log_dropped(0);
+
+static om_status_t print_log(om_msg_t *msg, void *arg) {
+  XB_UNUSED(arg);
+
+  om_log_t *log = static_cast<om_log_t *>(msg->buff);
+
+  LogRecord record;
+  record.time = bsp_time_get();
+  size_t len = strnlen(log->data, sizeof(record.data) - 1);
+  memcpy(record.data, log->data, len);
+  record.data[len] = '\0';
+
+  if (!log_queue->Send(record)) {
+    log_dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /* 每批日志只唤醒一次输出线程 */
+  if (!log_pending.exchange(true, std::memory_order_acq_rel)) {
+    log_sem->Post();
+  }
+
+  return OM_OK;
+}
+#else
+static om_status_t print_log(om_msg_t *msg, void *arg) {
+  XB_UNUSED(arg);
+
+  om_log_t *log = static_cast<om_log_t *>(msg->buff);
+
+  output_log(bsp_time_get(), log->data);
 
   return OM_OK;
 }
+#endif
 
 Term::Term() {
   system("stty -icanon");
@@ -81,23 +115,41 @@ Term::Term() {
 
   ms_init(show_fun);
 
-  auto term_udp_thread_fn = [](void *arg) {
+#ifdef TERM_LOG_UDP_SERVER
+  bsp_udp_server_init(&term_udp_server, TERM_LOG_UDP_SERVER_PORT);
+  term_loop = term_udp_server.loop;
+#else
+  XB_UNUSED(term_udp_server);
+  term_loop = hloop_new(0);
+#endif
+
+#if TERM_LOG_DEFERRED
+  auto log_thread_fn = [](void *arg) {
     XB_UNUSED(arg);
-    bsp_udp_server_start(&term_udp_server);
-    while (true) {
-      System::Thread::Sleep(UINT32_MAX);
+
+    LogRecord record;
+
+    while (1) {
+      log_sem->Wait(UINT32_MAX);
+      log_pending.store(false, std::memory_order_release);
+
+      while (log_queue->Receive(record)) {
+        output_log(record.time, record.data);
+      }
+
+      uint32_t dropped = log_dropped.exchange(0, std::memory_order_relaxed);
+      if (dropped) {
+        ms_printf_insert("%u logs dropped.",
+                         static_cast<unsigned int>(dropped));
+      }
     }
   };
 
-#ifdef TERM_LOG_UDP_SERVER
-  bsp_udp_server_init(&term_udp_server, TERM_LOG_UDP_SERVER_PORT);
+  log_queue = new System::Queue<LogRecord, QUEUE_MPSC>(TERM_LOG_QUEUE_LEN);
+  log_sem = new System::Semaphore(0);
 
-  term_udp_thread.Create(term_udp_thread_fn, static_cast<void *>(0),
-                         "term_udp_thread", 512, System::Thread::HIGH);
-#else
-  XB_UNUSED(term_udp_server);
-  XB_UNUSED(term_udp_thread_fn);
-  XB_UNUSED(term_udp_thread);
+  log_thread.Create(log_thread_fn, static_cast<void *>(0), "term_log_thread",
+                    512, System::Thread::LOW);
 #endif
 
   om_config_topic(om_get_log_handle(), "d", print_log, NULL);
@@ -107,12 +159,18 @@ Term::Term() {
 
     ms_start();
 
+    hio_t *io = hio_get(term_loop, STDIN_FILENO);
+    hio_setcb_read(io, term_input_cb);
+    hio_read(io);
+
+#ifdef TERM_LOG_UDP_SERVER
+    bsp_udp_server_start(&term_udp_server);
+#else
+    hloop_run(term_loop);
+#endif
+
     while (1) {
-      if (kbhit()) {
-        ms_input(static_cast<char>(getchar()));
-      } else {
-        System::Thread::Sleep(10);
-      }
+      System::Thread::Sleep(UINT32_MAX);
     }
   };
 
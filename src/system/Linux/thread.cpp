@@ -0,0 +1,246 @@
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <thread.hpp>
+
+using namespace System;
+
+thread_local Thread::Notify* Thread::current_notify_ = NULL;
+
+static const uint32_t CPU_MASK[] = {
+    LINUX_THREAD_CPU_MASK_IDLE,   LINUX_THREAD_CPU_MASK_LOW,
+    LINUX_THREAD_CPU_MASK_MEDIUM, LINUX_THREAD_CPU_MASK_HIGH,
+    LINUX_THREAD_CPU_MASK_REALTIME};
+
+static void mask_to_cpu_set(uint32_t mask, cpu_set_t* set) {
+  CPU_ZERO(set);
+  for (int i = 0; i < 32; i++) {
+    if (mask & (1U << i)) {
+      CPU_SET(i, set);
+    }
+  }
+}
+
+void Thread::ConfigAttr(pthread_attr_t* attr, size_t stack_depth,
+                        Priority priority) {
+  pthread_attr_setstacksize(attr, StackSize(stack_depth));
+
+  struct sched_param param = {};
+  int policy = SCHED_OTHER;
+
+#if LINUX_THREAD_RT_SCHED
+  /* IDLE和LOW留在普通调度，避免日志和终端线程抢占控制线程 */
+  if (priority == IDLE) {
+    policy = SCHED_IDLE;
+  } else if (priority >= MEDIUM) {
+#if LINUX_THREAD_SCHED_RR
+    policy = SCHED_RR;
+#else
+    policy = SCHED_FIFO;
+#endif
+    param.sched_priority =
+        LINUX_THREAD_RT_PRIORITY_BASE + (priority - MEDIUM) * 10;
+  }
+#endif
+
+  pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED);
+  pthread_attr_setschedpolicy(attr, policy);
+  pthread_attr_setschedparam(attr, &param);
+
+  uint32_t mask = CPU_MASK[priority];
+  if (mask != 0) {
+    cpu_set_t set;
+    mask_to_cpu_set(mask, &set);
+    pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+  }
+}
+
+size_t Thread::StackSize(size_t stack_depth) {
+  size_t size = stack_depth * 4 * LINUX_THREAD_STACK_SCALE;
+
+  if (size < LINUX_THREAD_MIN_STACK_SIZE * 1024) {
+    size = LINUX_THREAD_MIN_STACK_SIZE * 1024;
+  }
+
+  if (size < static_cast<size_t>(PTHREAD_STACK_MIN)) {
+    size = PTHREAD_STACK_MIN;
+  }
+
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+  return (size + page - 1) / page * page;
+}
+
+void Thread::SetName(const char* name) {
+  /* 线程名最长15个字符 */
+  char buff[16];
+  strncpy(buff, name, sizeof(buff) - 1);
+  buff[sizeof(buff) - 1] = '\0';
+  pthread_setname_np(pthread_self(), buff);
+}
+
+Thread::Notify* Thread::CurrentNotify() {
+  if (current_notify_ == NULL) {
+    current_notify_ = new Notify;
+  }
+  return current_notify_;
+}
+
+bool Thread::SetAffinity(uint32_t mask) {
+  cpu_set_t set;
+
+  if (mask == 0) {
+    mask = UINT32_MAX;
+  }
+
+  mask_to_cpu_set(mask, &set);
+
+  return pthread_setaffinity_np(this->handle_, sizeof(set), &set) == 0;
+}
+
+/* 从当前时刻起等待delay微秒，使用绝对时间避免被信号打断后累积误差 */
+static void sleep_for(uint64_t delay) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  delay += static_cast<uint64_t>(ts.tv_nsec) / 1000;
+  ts.tv_sec += static_cast<time_t>(delay / 1000000);
+  ts.tv_nsec = static_cast<long>(delay % 1000000) * 1000;
+
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+  }
+}
+
+void Thread::SleepMicroseconds(uint32_t microseconds) {
+  sleep_for(microseconds);
+}
+
+/* 周期延时的截止时间，保存为CLOCK_MONOTONIC绝对时间，每次加一个周期。
+ * 只在首次调用或调用者改写了last_wakeup_time时按bsp_time换算一次，
+ * 之后不再读取bsp_time，换算误差和调度延迟不会逐周期累积 */
+typedef struct {
+  struct timespec time;
+  uint64_t ref; /* 与time对应的last_wakeup_time */
+  bool valid;
+} Deadline;
+
+static thread_local Deadline deadline_ms;
+static thread_local Deadline deadline_us;
+
+static void timespec_add(struct timespec* ts, int64_t ns) {
+  int64_t nsec = ts->tv_nsec + ns % 1000000000;
+  ts->tv_sec += static_cast<time_t>(ns / 1000000000);
+
+  if (nsec < 0) {
+    nsec += 1000000000;
+    ts->tv_sec--;
+  } else if (nsec >= 1000000000) {
+    nsec -= 1000000000;
+    ts->tv_sec++;
+  }
+
+  ts->tv_nsec = static_cast<long>(nsec);
+}
+
+static int64_t timespec_diff(const struct timespec& a,
+                             const struct timespec& b) {
+  return static_cast<int64_t>(a.tv_sec - b.tv_sec) * 1000000000 +
+         (a.tv_nsec - b.tv_nsec);
+}
+
+/* 等到下一个截止时间，返回截止时间前进的周期数。
+ * 错过截止时间时不睡眠，跳过已错过的周期保持相位，on_time为false。
+ * offset为last_wakeup_time与bsp_time当前值之差，只在resync时使用 */
+static uint64_t wait_period(Deadline& deadline, bool resync, int64_t offset,
+                            uint64_t period, bool* on_time) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  if (resync) {
+    deadline.time = now;
+    timespec_add(&deadline.time, offset);
+    deadline.valid = true;
+  }
+
+  struct timespec target = deadline.time;
+  timespec_add(&target, static_cast<int64_t>(period));
+
+  int64_t late = timespec_diff(now, target);
+  uint64_t count = 1;
+
+  if (late >= 0) {
+    *on_time = false;
+    if (static_cast<uint64_t>(late) >= period) {
+      uint64_t skip = static_cast<uint64_t>(late) / period;
+      timespec_add(&target, static_cast<int64_t>(skip * period));
+      count += skip;
+    }
+  } else {
+    *on_time = true;
+    if (static_cast<uint64_t>(-late) > period) {
+      /* last_wakeup_time超前，重新对齐 */
+      target = now;
+      timespec_add(&target, static_cast<int64_t>(period));
+    }
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL) ==
+           EINTR) {
+    }
+  }
+
+  deadline.time = target;
+
+  return count;
+}
+
+void Thread::SleepUntil(uint32_t microseconds, uint32_t& last_wakeup_time) {
+  if (microseconds == 0) {
+    last_wakeup_time = bsp_time_get_ms();
+    deadline_ms.valid = false;
+    return;
+  }
+
+  bool resync = !deadline_ms.valid || deadline_ms.ref != last_wakeup_time;
+  int64_t offset = 0;
+  if (resync) {
+    offset = static_cast<int64_t>(
+                 static_cast<int32_t>(last_wakeup_time - bsp_time_get_ms())) *
+             1000000;
+  }
+
+  bool on_time = true;
+  uint64_t count =
+      wait_period(deadline_ms, resync, offset,
+                  static_cast<uint64_t>(microseconds) * 1000000, &on_time);
+
+  last_wakeup_time += static_cast<uint32_t>(count * microseconds);
+  deadline_ms.ref = last_wakeup_time;
+}
+
+bool Thread::SleepUntilMicroseconds(uint32_t period,
+                                    uint64_t& last_wakeup_time) {
+  if (period == 0) {
+    last_wakeup_time = bsp_time_get_us();
+    deadline_us.valid = false;
+    return true;
+  }
+
+  bool resync = !deadline_us.valid || deadline_us.ref != last_wakeup_time;
+  int64_t offset = 0;
+  if (resync) {
+    offset = static_cast<int64_t>(last_wakeup_time - bsp_time_get_us()) * 1000;
+  }
+
+  bool on_time = true;
+  uint64_t count =
+      wait_period(deadline_us, resync, offset,
+                  static_cast<uint64_t>(period) * 1000, &on_time);
+
+  last_wakeup_time += count * period;
+  deadline_us.ref = last_wakeup_time;
+
+  return on_time;
+}
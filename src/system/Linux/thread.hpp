@@ -4,6 +4,7 @@
 #include <pthread.h>
 #include <stdint.h>
 
+#include <atomic>
 #include <csignal>
 #include <cstring>
 #include <memory.hpp>
@@ -24,9 +25,6 @@ class Thread {
   template <typename FunType, typename ArgType>
   void Create(FunType fun, ArgType arg, const char* name, size_t stack_depth,
               Priority priority) {
-    XB_UNUSED(name);
-    XB_UNUSED(priority);
-
     XB_UNUSED(static_cast<void (*)(ArgType)>(fun));
 
     class ThreadBlock {
@@ -39,14 +37,17 @@ class Thread {
       }
       TypeErasure<void, ArgType> type_;
       char* name_;
+      Notify* notify_;
     };
 
     auto block = new ThreadBlock(fun, arg, name);
+    this->notify_ = new Notify;
+    block->notify_ = this->notify_;
 
     auto port = [](void* arg) {
       ThreadBlock* block = static_cast<ThreadBlock*>(arg);
-      const char* name = block->name_;
-      XB_UNUSED(name);
+      SetName(block->name_);
+      current_notify_ = block->notify_;
       sigset_t waitset;
       sigfillset(&waitset);
       pthread_sigmask(SIG_BLOCK, &waitset, NULL);
@@ -56,15 +57,46 @@ class Thread {
 
     pthread_attr_t attr;
     pthread_attr_init(&attr);
-    if (stack_depth > 256) {
-      pthread_attr_setstacksize(&attr, stack_depth / 1024 * 4);
-    } else {
-      pthread_attr_setstacksize(&attr, 1);
+    ConfigAttr(&attr, stack_depth, priority);
+
+    if (pthread_create(&this->handle_, &attr, port, block) != 0) {
+      /* 没有实时调度权限时退回继承调度策略 */
+      pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+      int ans = pthread_create(&this->handle_, &attr, port, block);
+      XB_ASSERT(ans == 0);
+      XB_UNUSED(ans);
     }
-    pthread_create(&this->handle_, &attr, port, block);
+
+    pthread_attr_destroy(&attr);
+  }
+
+  /* 根据优先级设置调度策略、CPU亲和性和堆栈大小 */
+  static void ConfigAttr(pthread_attr_t* attr, size_t stack_depth,
+                         Priority priority);
+
+  /* stack_depth与FreeRTOS一致，以4字节为单位 */
+  static size_t StackSize(size_t stack_depth);
+
+  static void SetName(const char* name);
+
+  /* mask为0时不限制 */
+  bool SetAffinity(uint32_t mask);
+
+  static Thread Current(void) {
+    Thread thread(pthread_self());
+    thread.notify_ = CurrentNotify();
+    return thread;
   }
 
-  static Thread Current(void) { return Thread(pthread_self()); }
+  /* Signal使用的通知位，只由所属线程等待 */
+  class Notify {
+   public:
+    std::atomic<uint32_t> value{0};
+    std::atomic<uint32_t> waiting{0};
+  };
+
+  /* 非Create创建的线程(如主线程)首次使用时分配 */
+  static Notify* CurrentNotify();
 
   static void Sleep(uint32_t microseconds) {
     poll(NULL, 0, static_cast<int>(microseconds));
@@ -92,17 +124,23 @@ class Thread {
     }
   }
 
-  void SleepUntil(uint32_t microseconds, uint32_t& last_wakeup_time) {
-    while (bsp_time_get_ms() - last_wakeup_time < microseconds) {
-      poll(NULL, 0, 1);
-    }
-    last_wakeup_time += microseconds;
-  }
+  static void SleepMicroseconds(uint32_t microseconds);
+
+  /* 基于CLOCK_MONOTONIC绝对时间的周期延时 */
+  void SleepUntil(uint32_t microseconds, uint32_t& last_wakeup_time);
+
+  /* 微秒级周期延时，last_wakeup_time以bsp_time_get_us()为基准，
+   * 错过截止时间时跳过已错过的周期并返回false */
+  bool SleepUntilMicroseconds(uint32_t period, uint64_t& last_wakeup_time);
 
   void Delete() { pthread_cancel(this->handle_); }
 
   static void Yield() { sched_yield(); }
 
   pthread_t handle_;
+  Notify* notify_ = NULL;
+
+ private:
+  static thread_local Notify* current_notify_;
 };
 }  // namespace System
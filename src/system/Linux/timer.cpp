@@ -1,3 +1,5 @@
+#include <time.h>
+
 #include <timer.hpp>
 
 #include "bsp_time.h"
@@ -6,15 +8,48 @@ using namespace System;
 
 Timer* Timer::self_ = NULL;
 
+/* 没有定时器到期时的最长睡眠时间 */
+static const uint64_t TIMER_MAX_SLEEP_US = 1000000;
+
 Timer::Timer() {
   self_ = this;
 
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&cond_, &attr);
+  pthread_condattr_destroy(&attr);
+
   auto thread_fn = [](void* arg) {
     XB_UNUSED(arg);
-    uint32_t last_wakeup_time = bsp_time_get_ms();
+    Timer* self = Timer::self_;
+
+    pthread_mutex_lock(&self->mutex_);
+
     while (1) {
-      Timer::self_->list_.Foreach(Timer::Refresh, NULL);
-      Timer::self_->thread_.SleepUntil(1, last_wakeup_time);
+      uint64_t now = self->Now();
+      self->wheel_.Advance(now, [&](TimerWheel::Node* node) {
+        self->Expire(node, now);
+      });
+
+      now = self->Now();
+      uint64_t next = self->wheel_.Next();
+      uint64_t delay = next > now ? next - now : 0;
+      if (delay > TIMER_MAX_SLEEP_US) {
+        delay = TIMER_MAX_SLEEP_US;
+      }
+
+      if (delay == 0) {
+        continue;
+      }
+
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      delay += static_cast<uint64_t>(ts.tv_nsec) / 1000;
+      ts.tv_sec += static_cast<time_t>(delay / 1000000);
+      ts.tv_nsec = static_cast<long>(delay % 1000000) * 1000;
+
+      pthread_cond_timedwait(&self->cond_, &self->mutex_, &ts);
     }
   };
 
@@ -22,18 +57,126 @@ Timer::Timer() {
                        Thread::MEDIUM);
 }
 
-bool Timer::Refresh(ControlBlock& block, void* arg) {
-  XB_UNUSED(arg);
+uint64_t Timer::Now() { return bsp_time_get_us(); }
+
+void Timer::Arm(ControlBlock* block) {
+  block->expires_ = Now() + block->cycle;
+  wheel_.Add(block);
+  pthread_cond_signal(&cond_);
+}
+
+void Timer::Add(ControlBlock* block) {
+  pthread_mutex_lock(&mutex_);
+  block->next = list_;
+  list_ = block;
+  block->running = true;
+  Arm(block);
+  pthread_mutex_unlock(&mutex_);
+}
+
+void Timer::Expire(TimerWheel::Node* node, uint64_t now) {
+  ControlBlock* block = static_cast<ControlBlock*>(node);
+
+  uint64_t delay = now - block->expires_;
+  if (delay > block->max_delay) {
+    block->max_delay = static_cast<uint32_t>(delay);
+  }
+
+  block->count++;
+
+  if (block->mode == PERIODIC) {
+    /* 按原相位重新插入，错过的周期计入overrun */
+    uint64_t missed = delay / block->cycle;
+    block->overrun += static_cast<uint32_t>(missed);
+    block->expires_ += (missed + 1) * block->cycle;
+    wheel_.Add(block);
+  } else {
+    block->running = false;
+  }
+
+  auto fun = block->fun;
+  auto type = block->type;
+
+  /* 回调中允许操作定时器 */
+  pthread_mutex_unlock(&mutex_);
+  fun(type);
+  pthread_mutex_lock(&mutex_);
+}
+
+void Timer::Delete(TimerHandle& handle) {
+  pthread_mutex_lock(&self_->mutex_);
+  self_->wheel_.Remove(handle);
+  for (ControlBlock** pos = &self_->list_; *pos; pos = &(*pos)->next) {
+    if (*pos == handle) {
+      *pos = handle->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&self_->mutex_);
+  delete (handle);
+}
+
+void Timer::Start(TimerHandle& handle) {
+  pthread_mutex_lock(&self_->mutex_);
+  if (!handle->running) {
+    handle->running = true;
+    self_->Arm(handle);
+  }
+  pthread_mutex_unlock(&self_->mutex_);
+}
+
+void Timer::Stop(TimerHandle& handle) {
+  pthread_mutex_lock(&self_->mutex_);
+  handle->running = false;
+  self_->wheel_.Remove(handle);
+  pthread_mutex_unlock(&self_->mutex_);
+}
+
+void Timer::SetCycle(TimerHandle& timer, uint32_t cycle) {
+  SetCycleMicroseconds(timer, (cycle ? cycle : 1) * 1000);
+}
+
+void Timer::SetCycleMicroseconds(TimerHandle& timer, uint32_t cycle) {
+  pthread_mutex_lock(&self_->mutex_);
+  timer->cycle = cycle ? cycle : 1;
+  if (timer->Linked()) {
+    self_->wheel_.Remove(timer);
+    self_->Arm(timer);
+  }
+  pthread_mutex_unlock(&self_->mutex_);
+}
 
-  if (!block.running) {
-    return true;
+int Timer::ShowCMD(Timer* timer, int argc, char** argv) {
+  if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+    pthread_mutex_lock(&timer->mutex_);
+    for (ControlBlock* pos = timer->list_; pos; pos = pos->next) {
+      pos->count = 0;
+      pos->overrun = 0;
+      pos->max_delay = 0;
+    }
+    pthread_mutex_unlock(&timer->mutex_);
+    return 0;
   }
 
-  block.count++;
-  if (block.cycle <= block.count) {
-    block.count = 0;
-    block.fun(block.type);
+  if (argc != 1) {
+    printf("[reset] 清空统计数据\r\n");
+    return 0;
+  }
+
+  printf("%-16s %-8s %12s %10s %10s %14s\r\n", "name", "state", "cycle(us)",
+         "count", "overrun", "max delay(us)");
+
+  pthread_mutex_lock(&timer->mutex_);
+  for (ControlBlock* pos = timer->list_; pos; pos = pos->next) {
+    printf("%-16s %-8s %12u %10u %10u %14u\r\n", pos->name,
+           pos->running ? (pos->mode == PERIODIC ? "periodic" : "oneshot")
+                        : "stop",
+           static_cast<unsigned int>(pos->cycle),
+           static_cast<unsigned int>(pos->count),
+           static_cast<unsigned int>(pos->overrun),
+           static_cast<unsigned int>(pos->max_delay));
   }
+  pthread_mutex_unlock(&timer->mutex_);
 
-  return true;
+  return 0;
 }
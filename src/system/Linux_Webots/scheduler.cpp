@@ -0,0 +1,304 @@
+#include <webots/robot.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <scheduler.hpp>
+
+#include "bsp_time.h"
+
+using namespace System;
+
+pthread_mutex_t Scheduler::mutex_ = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t Scheduler::idle_cond_ = PTHREAD_COND_INITIALIZER;
+Scheduler::Task* Scheduler::list_ = NULL;
+Scheduler::Task* Scheduler::ready_head_ = NULL;
+Scheduler::Task* Scheduler::ready_tail_ = NULL;
+Scheduler::Task* Scheduler::running_ = NULL;
+uint32_t Scheduler::task_num_ = 0;
+bool Scheduler::stepping_ = false;
+thread_local Scheduler::Task* Scheduler::current_ = NULL;
+
+void Scheduler::Lock() { pthread_mutex_lock(&mutex_); }
+
+void Scheduler::Unlock() { pthread_mutex_unlock(&mutex_); }
+
+uint64_t Scheduler::Now() { return bsp_time_get_us(); }
+
+void Scheduler::Enqueue(Task* task) {
+  task->state = READY;
+  task->ready_next = NULL;
+  if (ready_tail_) {
+    ready_tail_->ready_next = task;
+  } else {
+    ready_head_ = task;
+  }
+  ready_tail_ = task;
+}
+
+void Scheduler::Dispatch() {
+  /* 仿真步进期间由主线程在步进结束后分派 */
+  if (running_ || stepping_) {
+    return;
+  }
+
+  if (ready_head_ == NULL) {
+    pthread_cond_signal(&idle_cond_);
+    return;
+  }
+
+  Task* task = ready_head_;
+  ready_head_ = task->ready_next;
+  if (ready_head_ == NULL) {
+    ready_tail_ = NULL;
+  }
+
+  task->state = RUNNING;
+  running_ = task;
+  pthread_cond_signal(&task->cond);
+}
+
+static void scheduler_unlock(void* arg) {
+  pthread_mutex_unlock(static_cast<pthread_mutex_t*>(arg));
+}
+
+void Scheduler::WaitRunning(Task* task) {
+  /* 线程在等待时被pthread_cancel也要释放锁 */
+  pthread_cleanup_push(scheduler_unlock, &mutex_);
+  while (task->state != RUNNING) {
+    pthread_cond_wait(&task->cond, &mutex_);
+  }
+  pthread_cleanup_pop(0);
+}
+
+Scheduler::Task* Scheduler::Register() {
+  Task* task = new Task;
+  task->handle = 0;
+  pthread_cond_init(&task->cond, NULL);
+  task->deadline = FOREVER;
+  task->timeout = false;
+  task->signal = 0;
+  task->signal_wait = 0;
+  task->next = NULL;
+
+  Lock();
+  task->id = task_num_++;
+
+  Task** pos = &list_;
+  while (*pos) {
+    pos = &(*pos)->next;
+  }
+  *pos = task;
+
+  Enqueue(task);
+  Dispatch();
+  Unlock();
+
+  return task;
+}
+
+void Scheduler::Start(Task* task) {
+  Lock();
+  task->handle = pthread_self();
+  current_ = task;
+  WaitRunning(task);
+  Unlock();
+}
+
+void Scheduler::Remove(Task* task) {
+  Lock();
+
+  for (Task** pos = &list_; *pos; pos = &(*pos)->next) {
+    if (*pos == task) {
+      *pos = task->next;
+      break;
+    }
+  }
+
+  for (Task** pos = &ready_head_; *pos; pos = &(*pos)->ready_next) {
+    if (*pos == task) {
+      *pos = task->ready_next;
+      if (ready_tail_ == task) {
+        ready_tail_ = NULL;
+        for (Task* it = ready_head_; it; it = it->ready_next) {
+          ready_tail_ = it;
+        }
+      }
+      break;
+    }
+  }
+
+  if (running_ == task) {
+    running_ = NULL;
+  }
+
+  if (current_ == task) {
+    current_ = NULL;
+  }
+
+  Dispatch();
+  Unlock();
+}
+
+void Scheduler::Detach() {
+  Lock();
+  Task* task = current_;
+  if (task && task->state == RUNNING) {
+    task->state = DETACHED;
+    running_ = NULL;
+    Dispatch();
+  }
+  Unlock();
+}
+
+void Scheduler::Attach() {
+  Lock();
+  Task* task = Self();
+  if (task->state == DETACHED) {
+    Enqueue(task);
+    Dispatch();
+    WaitRunning(task);
+  }
+  Unlock();
+}
+
+Scheduler::Task* Scheduler::Self() {
+  if (current_) {
+    return current_;
+  }
+
+  /* 不是由Thread::Create创建的线程 */
+  Unlock();
+  Task* task = Register();
+  Lock();
+  task->handle = pthread_self();
+  current_ = task;
+  WaitRunning(task);
+  return task;
+}
+
+Scheduler::Task* Scheduler::Find(pthread_t handle) {
+  for (Task* task = list_; task; task = task->next) {
+    if (pthread_equal(task->handle, handle)) {
+      return task;
+    }
+  }
+  return NULL;
+}
+
+bool Scheduler::Block(uint64_t deadline) {
+  Task* task = Self();
+
+  task->state = BLOCKED;
+  task->deadline = deadline;
+  task->timeout = false;
+
+  if (running_ == task) {
+    running_ = NULL;
+  }
+  Dispatch();
+
+  WaitRunning(task);
+
+  return !task->timeout;
+}
+
+void Scheduler::Wake(Task* task) {
+  if (task->state != BLOCKED) {
+    return;
+  }
+
+  Enqueue(task);
+  Dispatch();
+}
+
+void Scheduler::Yield() {
+  Task* task = Self();
+
+  if (ready_head_ == NULL) {
+    return;
+  }
+
+  running_ = NULL;
+  Enqueue(task);
+  Dispatch();
+  WaitRunning(task);
+}
+
+void Scheduler::Run() {
+  int basic_step =
+      static_cast<int>(std::lround(wb_robot_get_basic_time_step()));
+  if (basic_step < 1) {
+    basic_step = 1;
+  }
+
+  Lock();
+
+  while (1) {
+    if (running_) {
+      pthread_cond_wait(&idle_cond_, &mutex_);
+      continue;
+    }
+
+    if (ready_head_) {
+      Dispatch();
+      continue;
+    }
+
+    /* 所有任务都已阻塞，按截止时间和登记顺序唤醒已到期的任务 */
+    uint64_t now = Now();
+    uint64_t next = FOREVER;
+    bool woken = false;
+
+    while (1) {
+      Task* select = NULL;
+      for (Task* task = list_; task; task = task->next) {
+        if (task->state == BLOCKED && task->deadline <= now &&
+            (select == NULL || task->deadline < select->deadline)) {
+          select = task;
+        }
+      }
+
+      if (select == NULL) {
+        break;
+      }
+
+      select->timeout = true;
+      Enqueue(select);
+      woken = true;
+    }
+
+    if (woken) {
+      continue;
+    }
+
+    for (Task* task = list_; task; task = task->next) {
+      if (task->state == BLOCKED && task->deadline < next) {
+        next = task->deadline;
+      }
+    }
+
+    /* 直接跳到最近的截止时间，仍按基本步长的整数倍推进 */
+    int step = basic_step;
+    if (next != FOREVER) {
+      uint64_t steps =
+          ((next - now + 999) / 1000 + basic_step - 1) / basic_step;
+      if (steps > 1) {
+        step = static_cast<int>(steps > 1000 ? 1000 : steps) * basic_step;
+      }
+    }
+
+    stepping_ = true;
+    Unlock();
+
+    int ans = wb_robot_step(step);
+
+    Lock();
+    stepping_ = false;
+
+    if (ans == -1) {
+      Unlock();
+      wb_robot_cleanup();
+      exit(0);
+    }
+  }
+}
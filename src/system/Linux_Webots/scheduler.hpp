@@ -0,0 +1,92 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <cstdint>
+
+namespace System {
+/* 仿真时间的锁步调度器。通过Thread::Create创建的线程都登记在这里，
+ * 同一时刻只有一个登记的线程在运行，线程阻塞在Sleep/Semaphore/Signal上时
+ * 把运行权交给下一个就绪线程。所有线程都阻塞后主线程才调用wb_robot_step
+ * 推进仿真时间，再按截止时间和登记顺序依次唤醒线程，
+ * 因此仿真结果可以复现，且运行速度不受实际时间限制。 */
+class Scheduler {
+ public:
+  typedef enum { READY, RUNNING, BLOCKED, DETACHED } State;
+
+  class Task {
+   public:
+    pthread_t handle;
+    pthread_cond_t cond;
+    uint32_t id; /* 登记顺序 */
+    State state;
+    uint64_t deadline;    /* 单位：us，UINT64_MAX表示一直等待 */
+    bool timeout;         /* 因到达截止时间被唤醒 */
+    uint32_t signal;      /* 收到的Signal */
+    uint32_t signal_wait; /* 正在等待的Signal */
+    Task* next;
+    Task* ready_next;
+  };
+
+  /* 无限等待 */
+  static const uint64_t FOREVER = UINT64_MAX;
+
+  static void Lock();
+
+  static void Unlock();
+
+  /* 为即将创建的线程登记一个就绪任务，保证登记顺序与创建顺序一致 */
+  static Task* Register();
+
+  /* 新线程入口调用，等待获得运行权 */
+  static void Start(Task* task);
+
+  /* 线程退出或被删除时注销 */
+  static void Remove(Task* task);
+
+  /* 当前线程暂时退出调度，用于阻塞在外部IO(如终端输入)上的线程 */
+  static void Detach();
+
+  /* 重新加入调度并等待运行权 */
+  static void Attach();
+
+  /* 以下接口需要持有锁 */
+
+  /* 当前线程的任务，未登记的线程会在这里加入调度 */
+  static Task* Self();
+
+  static Task* Find(pthread_t handle);
+
+  /* 交出运行权，直到被Wake或到达deadline，超时返回false */
+  static bool Block(uint64_t deadline);
+
+  /* 唤醒阻塞的任务，放入就绪队列末尾 */
+  static void Wake(Task* task);
+
+  /* 让出运行权给其他就绪任务 */
+  static void Yield();
+
+  /* 当前仿真时间 单位：us */
+  static uint64_t Now();
+
+  /* 主线程调用，推进仿真时间，仿真结束时退出进程 */
+  static void Run();
+
+ private:
+  static void Enqueue(Task* task);
+
+  static void Dispatch();
+
+  static void WaitRunning(Task* task);
+
+  static pthread_mutex_t mutex_;
+  static pthread_cond_t idle_cond_;
+  static Task* list_;
+  static Task* ready_head_;
+  static Task* ready_tail_;
+  static Task* running_;
+  static uint32_t task_num_;
+  static bool stepping_;
+  static thread_local Task* current_;
+};
+}  // namespace System
@@ -1,54 +1,101 @@
 #pragma once
 
-#include <poll.h>
-#include <semaphore.h>
-
 #include <cstdint>
 #include <cstdio>
+#include <scheduler.hpp>
 #include <thread.hpp>
 
 #include "bsp_time.h"
 
 namespace System {
+/* 基于仿真时间的信号量，等待期间把运行权交给Scheduler */
 class Semaphore {
  public:
-  Semaphore(uint16_t init_count) { sem_init(&this->handle_, 0, init_count); }
+  Semaphore(uint16_t init_count) : count_(init_count) {}
+
+  void Post() {
+    Scheduler::Lock();
+
+    /* 已超时但还未运行的等待者不再接收 */
+    while (waiter_head_) {
+      Waiter* waiter = waiter_head_;
+      Remove(waiter);
+      if (waiter->task->state == Scheduler::BLOCKED) {
+        waiter->posted = true;
+        Scheduler::Wake(waiter->task);
+        Scheduler::Unlock();
+        return;
+      }
+    }
 
-  void Post() { sem_post(&this->handle_); }
+    count_++;
+    Scheduler::Unlock();
+  }
 
   bool Wait(uint32_t timeout = UINT32_MAX) {
-    if (!sem_trywait(&this->handle_)) {
+    Scheduler::Lock();
+
+    Scheduler::Task* task = Scheduler::Self();
+
+    if (count_ > 0) {
+      count_--;
+      Scheduler::Unlock();
       return true;
     }
 
     if (!timeout) {
+      Scheduler::Unlock();
       return false;
     }
 
-    uint32_t start_time = bsp_time_get_ms();
-    bool ans = false;
+    Waiter waiter = {task, false, NULL};
+    if (waiter_tail_) {
+      waiter_tail_->next = &waiter;
+    } else {
+      waiter_head_ = &waiter;
+    }
+    waiter_tail_ = &waiter;
+
+    Scheduler::Block(timeout == UINT32_MAX
+                         ? Scheduler::FOREVER
+                         : Scheduler::Now() +
+                               static_cast<uint64_t>(timeout) * 1000);
+
+    if (!waiter.posted) {
+      Remove(&waiter);
+    }
 
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
+    Scheduler::Unlock();
 
-    uint32_t add = 0;
-    long raw_time = 1U * 1000U * 1000U + ts.tv_nsec;
-    add = raw_time / (1000U * 1000U * 1000U);
+    return waiter.posted;
+  }
 
-    ts.tv_sec += add;
-    ts.tv_nsec = raw_time % (1000U * 1000U * 1000U);
+ private:
+  typedef struct Waiter {
+    Scheduler::Task* task;
+    bool posted;
+    struct Waiter* next;
+  } Waiter;
 
-    while (bsp_time_get_ms() - start_time < timeout) {
-      ans = !sem_timedwait(&handle_, &ts);
-      if (ans) {
-        return true;
+  void Remove(Waiter* waiter) {
+    Waiter* prev = NULL;
+    for (Waiter* pos = waiter_head_; pos; prev = pos, pos = pos->next) {
+      if (pos == waiter) {
+        if (prev) {
+          prev->next = pos->next;
+        } else {
+          waiter_head_ = pos->next;
+        }
+        if (waiter_tail_ == pos) {
+          waiter_tail_ = prev;
+        }
+        return;
       }
     }
-
-    return false;
   }
 
- private:
-  sem_t handle_;
+  uint32_t count_;
+  Waiter* waiter_head_ = NULL;
+  Waiter* waiter_tail_ = NULL;
 };
 }  // namespace System
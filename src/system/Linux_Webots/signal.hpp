@@ -1,55 +1,57 @@
 #pragma once
 
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <unistd.h>
-
-#include <csignal>
 #include <cstdint>
+#include <scheduler.hpp>
 #include <thread.hpp>
 
 #include "bsp_def.h"
 
 namespace System {
+/* 每个线程最多32个信号，等待基于仿真时间 */
 class Signal {
  public:
   static bool Action(System::Thread& thread, int sig) {
-    sig += SIGRTMIN;
-    XB_ASSERT(sig >= SIGRTMIN && sig <= SIGRTMAX);
-    return pthread_kill(thread.handle_, sig) == 0;
+    XB_ASSERT(sig >= 0 && sig < 32);
+
+    Scheduler::Lock();
+    Scheduler::Task* task = Scheduler::Find(thread.handle_);
+    if (task == NULL) {
+      Scheduler::Unlock();
+      return false;
+    }
+
+    task->signal |= 1U << sig;
+    if (task->signal_wait & task->signal) {
+      Scheduler::Wake(task);
+    }
+    Scheduler::Unlock();
+
+    return true;
   }
 
   static bool Wait(int sig, uint32_t timeout) {
-    sigset_t waitset, oldset;
-    sig += SIGRTMIN;
-    XB_ASSERT(sig >= SIGRTMIN && sig <= SIGRTMAX);
-
-    uint32_t start_time = bsp_time_get_ms();
+    XB_ASSERT(sig >= 0 && sig < 32);
 
-    sigemptyset(&waitset);
-    sigaddset(&waitset, sig);
-    pthread_sigmask(SIG_BLOCK, &waitset, &oldset);
+    uint32_t mask = 1U << sig;
 
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
+    Scheduler::Lock();
+    Scheduler::Task* task = Scheduler::Self();
 
-    uint32_t add = 0;
-    long raw_time = 1U * 1000U * 1000U + ts.tv_nsec;
-    add = raw_time / (1000U * 1000U * 1000U);
+    if (!(task->signal & mask) && timeout) {
+      task->signal_wait = mask;
+      Scheduler::Block(timeout == UINT32_MAX
+                           ? Scheduler::FOREVER
+                           : Scheduler::Now() +
+                                 static_cast<uint64_t>(timeout) * 1000);
+      task->signal_wait = 0;
+    }
 
-    ts.tv_sec += add;
-    ts.tv_nsec = raw_time % (1000U * 1000U * 1000U);
+    bool ans = task->signal & mask;
+    task->signal &= ~mask;
 
-    int res = sigtimedwait(&waitset, NULL, &ts);
+    Scheduler::Unlock();
 
-    while (bsp_time_get_ms() - start_time < timeout) {
-      res = !sigtimedwait(&waitset, NULL, &ts);
-      if (res) {
-        return true;
-      }
-    }
-    pthread_sigmask(SIG_BLOCK, &oldset, NULL);
-    return res == sig;
+    return ans;
   }
 };
 
@@ -20,6 +20,7 @@ void Start(RobotParam... param) {
     new Term();
     new Database();
     new Timer();
+    new Term::Command<Timer*>(Timer::self_, Timer::ShowCMD, "timer");
 
     if (wb_robot_get_basic_time_step() >= 2.0f) {
       OMLOG_WARNING(
@@ -32,7 +33,7 @@ void Start(RobotParam... param) {
     XB_UNUSED(xrobot_debug_handle);
 
     while (1) {
-      poll(NULL, 0, UINT32_MAX);
+      System::Thread::Sleep(UINT32_MAX);
     }
   };
 
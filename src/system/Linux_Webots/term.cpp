@@ -45,7 +45,11 @@ Term::Term() {
     ms_start();
 
     while (1) {
-      ms_input(static_cast<char>(getchar()));
+      /* 等待输入时不参与锁步调度，以免阻塞仿真 */
+      System::Scheduler::Detach();
+      int ch = getchar();
+      System::Scheduler::Attach();
+      ms_input(static_cast<char>(ch));
     }
   };
 
@@ -8,6 +8,7 @@
 #include <cstdint>
 #include <cstring>
 #include <memory.hpp>
+#include <scheduler.hpp>
 #include <string>
 
 #include "bsp_def.h"
@@ -35,11 +36,13 @@ class Thread {
       ThreadBlock(FunType fun, ArgType arg, const char* name)
           : type_(fun, arg),
             name_(reinterpret_cast<char*>(
-                System::Memory::Malloc(strlen(name) + 1))) {
+                System::Memory::Malloc(strlen(name) + 1))),
+            task_(Scheduler::Register()) {
         strcpy(name_, name);
       }
       TypeErasure<void, ArgType> type_;
       char* name_;
+      Scheduler::Task* task_;
     };
 
     auto block = new ThreadBlock(fun, arg, name);
@@ -51,7 +54,9 @@ class Thread {
       sigset_t waitset;
       sigfillset(&waitset);
       pthread_sigmask(SIG_BLOCK, &waitset, NULL);
+      Scheduler::Start(block->task_);
       block->type_.fun_(block->type_.arg_);
+      Scheduler::Remove(block->task_);
       return static_cast<void*>(NULL);
     };
 
@@ -67,28 +72,15 @@ class Thread {
 
   static Thread Current(void) { return Thread(pthread_self()); }
 
+  /* 以下延时均基于仿真时间，由Scheduler在仿真时间到达后唤醒 */
   static void Sleep(uint32_t microseconds) {
-    uint32_t time = bsp_time_get_ms() + microseconds;
-
-    while (bsp_time_get_ms() < time) {
-      poll(NULL, 0, 1);
-    }
+    SleepFor(static_cast<uint64_t>(microseconds) * 1000);
   }
 
-  static void SleepMilliseconds(uint32_t microseconds) {
-    uint32_t time = bsp_time_get_ms() + microseconds;
-
-    while (bsp_time_get_ms() < time) {
-      poll(NULL, 0, 1);
-    }
-  }
+  static void SleepMilliseconds(uint32_t microseconds) { Sleep(microseconds); }
 
   static void SleepSeconds(uint32_t seconds) {
-    float time = bsp_time_get() + static_cast<float>(seconds);
-
-    while (bsp_time_get() < time) {
-      poll(NULL, 0, 1);
-    }
+    SleepFor(static_cast<uint64_t>(seconds) * 1000000);
   }
 
   static void SleepMinutes(uint32_t minutes) { SleepSeconds(minutes * 60); }
@@ -106,20 +98,79 @@ class Thread {
   }
 
   void SleepUntil(uint32_t microseconds, uint32_t& last_wakeup_time) {
+    uint32_t now = bsp_time_get_ms();
+
     if (last_wakeup_time == 0) {
-      last_wakeup_time = bsp_time_get_ms();
+      last_wakeup_time = now;
     }
 
-    while (bsp_time_get_ms() - last_wakeup_time < microseconds) {
-      poll(NULL, 0, 1);
-    }
     last_wakeup_time += microseconds;
+
+    int32_t remain = static_cast<int32_t>(last_wakeup_time - now);
+
+    if (remain > 0) {
+      SleepFor(static_cast<uint64_t>(remain) * 1000);
+    } else if (microseconds != 0 &&
+               static_cast<uint32_t>(-remain) >= microseconds) {
+      /* 跳过错过的周期，保持相位 */
+      last_wakeup_time = now - static_cast<uint32_t>(-remain) % microseconds;
+    }
   }
 
-  void Delete() { pthread_cancel(this->handle_); }
+  static void SleepMicroseconds(uint32_t microseconds) {
+    SleepFor(microseconds);
+  }
+
+  /* 仿真时间下的微秒级周期延时，错过截止时间时跳过已错过的周期并返回false */
+  bool SleepUntilMicroseconds(uint32_t period, uint64_t& last_wakeup_time) {
+    uint64_t now = bsp_time_get_us();
 
-  static void Yield() { pthread_yield(); }
+    if (last_wakeup_time == 0) {
+      last_wakeup_time = now;
+    }
+
+    uint64_t target = last_wakeup_time + period;
+
+    if (target <= now) {
+      last_wakeup_time = target;
+      if (period != 0 && now - target >= period) {
+        last_wakeup_time = now - (now - target) % period;
+      }
+      return period == 0;
+    }
+
+    Scheduler::Lock();
+    Scheduler::Block(target);
+    Scheduler::Unlock();
+
+    last_wakeup_time = target;
+
+    return true;
+  }
+
+  void Delete() {
+    Scheduler::Lock();
+    Scheduler::Task* task = Scheduler::Find(this->handle_);
+    Scheduler::Unlock();
+    if (task) {
+      Scheduler::Remove(task);
+    }
+    pthread_cancel(this->handle_);
+  }
+
+  static void Yield() {
+    Scheduler::Lock();
+    Scheduler::Yield();
+    Scheduler::Unlock();
+  }
 
   pthread_t handle_;
+
+ private:
+  static void SleepFor(uint64_t microseconds) {
+    Scheduler::Lock();
+    Scheduler::Block(Scheduler::Now() + microseconds);
+    Scheduler::Unlock();
+  }
 };
 }  // namespace System
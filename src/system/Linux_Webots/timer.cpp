@@ -1,20 +1,30 @@
 #include <timer.hpp>
 
+#include "bsp_time.h"
+
 using namespace System;
 
 Timer* Timer::self_ = NULL;
 
-Timer::Timer() {
+Timer::Timer() : last_raw_time_(static_cast<uint32_t>(bsp_time_get_us())) {
   self_ = this;
 
+  /* 每1ms仿真时间推进一次时间轮 */
   auto thread_fn = [](void* arg) {
     XB_UNUSED(arg);
+    Timer* self = Timer::self_;
 
     uint32_t last_wakeup_time = bsp_time_get_ms();
 
     while (1) {
-      Timer::self_->list_.Foreach(Timer::Refresh, NULL);
-      Timer::self_->thread_.SleepUntil(1, last_wakeup_time);
+      pthread_mutex_lock(&self->mutex_);
+      uint64_t now = self->Now();
+      self->wheel_.Advance(now, [&](TimerWheel::Node* node) {
+        self->Expire(node, now);
+      });
+      pthread_mutex_unlock(&self->mutex_);
+
+      self->thread_.SleepUntil(1, last_wakeup_time);
     }
   };
 
@@ -22,18 +32,130 @@ Timer::Timer() {
                        Thread::MEDIUM);
 }
 
-bool Timer::Refresh(ControlBlock& block, void* arg) {
-  XB_UNUSED(arg);
+uint64_t Timer::Now() {
+  uint32_t raw = static_cast<uint32_t>(bsp_time_get_us());
+  time_ += static_cast<uint32_t>(raw - last_raw_time_);
+  last_raw_time_ = raw;
+  return time_;
+}
+
+void Timer::Arm(ControlBlock* block) {
+  block->expires_ = Now() + block->cycle;
+  wheel_.Add(block);
+}
+
+void Timer::Add(ControlBlock* block) {
+  pthread_mutex_lock(&mutex_);
+  block->next = list_;
+  list_ = block;
+  block->running = true;
+  Arm(block);
+  pthread_mutex_unlock(&mutex_);
+}
+
+void Timer::Expire(TimerWheel::Node* node, uint64_t now) {
+  ControlBlock* block = static_cast<ControlBlock*>(node);
+
+  uint64_t delay = now - block->expires_;
+  if (delay > block->max_delay) {
+    block->max_delay = static_cast<uint32_t>(delay);
+  }
+
+  block->count++;
+
+  if (block->mode == PERIODIC) {
+    /* 按原相位重新插入，错过的周期计入overrun */
+    uint64_t missed = delay / block->cycle;
+    block->overrun += static_cast<uint32_t>(missed);
+    block->expires_ += (missed + 1) * block->cycle;
+    wheel_.Add(block);
+  } else {
+    block->running = false;
+  }
+
+  auto fun = block->fun;
+  auto type = block->type;
+
+  /* 回调中允许操作定时器 */
+  pthread_mutex_unlock(&mutex_);
+  fun(type);
+  pthread_mutex_lock(&mutex_);
+}
+
+void Timer::Delete(TimerHandle& handle) {
+  pthread_mutex_lock(&self_->mutex_);
+  self_->wheel_.Remove(handle);
+  for (ControlBlock** pos = &self_->list_; *pos; pos = &(*pos)->next) {
+    if (*pos == handle) {
+      *pos = handle->next;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&self_->mutex_);
+  delete (handle);
+}
 
-  if (!block.running) {
-    return true;
+void Timer::Start(TimerHandle& handle) {
+  pthread_mutex_lock(&self_->mutex_);
+  if (!handle->running) {
+    handle->running = true;
+    self_->Arm(handle);
   }
+  pthread_mutex_unlock(&self_->mutex_);
+}
+
+void Timer::Stop(TimerHandle& handle) {
+  pthread_mutex_lock(&self_->mutex_);
+  handle->running = false;
+  self_->wheel_.Remove(handle);
+  pthread_mutex_unlock(&self_->mutex_);
+}
+
+void Timer::SetCycle(TimerHandle& timer, uint32_t cycle) {
+  SetCycleMicroseconds(timer, (cycle ? cycle : 1) * 1000);
+}
+
+void Timer::SetCycleMicroseconds(TimerHandle& timer, uint32_t cycle) {
+  pthread_mutex_lock(&self_->mutex_);
+  timer->cycle = cycle ? cycle : 1;
+  if (timer->Linked()) {
+    self_->wheel_.Remove(timer);
+    self_->Arm(timer);
+  }
+  pthread_mutex_unlock(&self_->mutex_);
+}
+
+int Timer::ShowCMD(Timer* timer, int argc, char** argv) {
+  if (argc == 2 && strcmp(argv[1], "reset") == 0) {
+    pthread_mutex_lock(&timer->mutex_);
+    for (ControlBlock* pos = timer->list_; pos; pos = pos->next) {
+      pos->count = 0;
+      pos->overrun = 0;
+      pos->max_delay = 0;
+    }
+    pthread_mutex_unlock(&timer->mutex_);
+    return 0;
+  }
+
+  if (argc != 1) {
+    printf("[reset] 清空统计数据\r\n");
+    return 0;
+  }
+
+  printf("%-16s %-8s %12s %10s %10s %14s\r\n", "name", "state", "cycle(us)",
+         "count", "overrun", "max delay(us)");
 
-  block.count++;
-  if (block.cycle <= block.count) {
-    block.count = 0;
-    block.fun(block.type);
+  pthread_mutex_lock(&timer->mutex_);
+  for (ControlBlock* pos = timer->list_; pos; pos = pos->next) {
+    printf("%-16s %-8s %12u %10u %10u %14u\r\n", pos->name,
+           pos->running ? (pos->mode == PERIODIC ? "periodic" : "oneshot")
+                        : "stop",
+           static_cast<unsigned int>(pos->cycle),
+           static_cast<unsigned int>(pos->count),
+           static_cast<unsigned int>(pos->overrun),
+           static_cast<unsigned int>(pos->max_delay));
   }
+  pthread_mutex_unlock(&timer->mutex_);
 
-  return true;
+  return 0;
 }
@@ -1,58 +1,95 @@
 #pragma once
 
-#include <list.hpp>
+#include <pthread.h>
+
 #include <thread.hpp>
 
 #include "system_ext.hpp"
+#include "timer_wheel.hpp"
 
 namespace System {
 class Timer {
  public:
-  typedef struct {
+  typedef enum { PERIODIC, ONE_SHOT } Mode;
+
+  class ControlBlock : public TimerWheel::Node {
+   public:
     void* type;
     void (*fun)(void*);
-    uint16_t cycle;
-    uint16_t count;
+    const char* name;
+    uint32_t cycle; /* 周期 单位：us */
+    Mode mode;
     bool running;
-  } ControlBlock;
+    uint32_t count;     /* 执行次数 */
+    uint32_t overrun;   /* 错过的周期数 */
+    uint32_t max_delay; /* 最大执行延迟 单位：us */
+    ControlBlock* next;
+  };
 
-  typedef System::List<ControlBlock>::Node* TimerHandle;
+  typedef ControlBlock* TimerHandle;
 
   Timer();
 
-  static bool Refresh(ControlBlock& block, void* arg);
+  /* cycle单位为ms，为0时按1ms处理 */
+  template <typename FunType, typename ArgType>
+  static TimerHandle Create(FunType fun, ArgType arg, uint32_t cycle,
+                            const char* name = "timer") {
+    return CreateMicroseconds(fun, arg, (cycle ? cycle : 1) * 1000, PERIODIC,
+                              name);
+  }
 
   template <typename FunType, typename ArgType>
-  static TimerHandle Create(FunType fun, ArgType arg, uint32_t cycle) {
+  static TimerHandle CreateMicroseconds(FunType fun, ArgType arg,
+                                        uint32_t cycle, Mode mode = PERIODIC,
+                                        const char* name = "timer") {
     (void)static_cast<void (*)(ArgType)>(fun);
     TypeErasure<void, ArgType>* type = static_cast<TypeErasure<void, ArgType>*>(
         malloc(sizeof(TypeErasure<void, ArgType>)));
     *type = TypeErasure<void, ArgType>(fun, arg);
-    auto block = new System::List<ControlBlock>::Node;
-    block->data_.count = 0;
-    block->data_.cycle = cycle;
-    block->data_.fun = type->Port;
-    block->data_.type = type;
-    block->data_.running = true;
-    self_->list_.Add(*block);
+    auto block = new ControlBlock;
+    block->type = type;
+    block->fun = type->Port;
+    block->name = name;
+    block->cycle = cycle ? cycle : 1;
+    block->mode = mode;
+    block->running = false;
+    block->count = 0;
+    block->overrun = 0;
+    block->max_delay = 0;
+    self_->Add(block);
     return block;
   }
 
-  static void Delete(TimerHandle& handle) {
-    self_->list_.Delete(*handle);
-    delete (handle);
-  }
+  static void Delete(TimerHandle& handle);
 
-  static void Start(TimerHandle& handle) { handle->data_.running = true; }
+  static void Start(TimerHandle& handle);
 
-  static void Stop(TimerHandle& handle) { handle->data_.running = false; }
+  static void Stop(TimerHandle& handle);
 
-  static void SetCycle(TimerHandle& timer, uint32_t cycle) {
-    timer->data_.cycle = cycle;
-  }
+  /* cycle单位为ms */
+  static void SetCycle(TimerHandle& timer, uint32_t cycle);
+
+  static void SetCycleMicroseconds(TimerHandle& timer, uint32_t cycle);
+
+  static int ShowCMD(Timer* timer, int argc, char** argv);
 
   static Timer* self_;
-  List<ControlBlock> list_;
+
+ private:
+  void Add(ControlBlock* block);
+
+  void Arm(ControlBlock* block);
+
+  void Expire(TimerWheel::Node* node, uint64_t now);
+
+  /* 将32位的bsp_time_get_us()扩展为64位 */
+  uint64_t Now();
+
+  TimerWheel wheel_;
+  ControlBlock* list_ = NULL;
+  uint64_t time_ = 0;
+  uint32_t last_raw_time_ = 0;
+  pthread_mutex_t mutex_ = PTHREAD_MUTEX_INITIALIZER;
   Thread thread_;
 };
 }  // namespace System
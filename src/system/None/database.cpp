@@ -1,6 +1,7 @@
 #include <cstring>
 #include <database.hpp>
 #include <term.hpp>
+#include <timer.hpp>
 
 #include "ms.h"
 
@@ -10,6 +11,110 @@ static uint8_t sn_buff[33];
 
 static ms_item_t sn_tools;
 
+Database::Entry* Database::list_ = NULL;
+
+/* 单次定时器，在主循环中执行写回 */
+static Timer::TimerHandle flush_timer;
+
+/* 磨损统计 */
+static uint32_t total_set = 0;      /* Set()调用次数 */
+static uint32_t total_write = 0;    /* 实际写入flash次数 */
+static uint32_t total_skip = 0;     /* 内容未改变而跳过的写入次数 */
+static uint32_t total_coalesce = 0; /* 被合并的Set()次数 */
+
+static uint32_t fnv1a(const uint8_t* buff, uint32_t len) {
+  uint32_t hash = 2166136261u;
+  while (len--) {
+    hash ^= *buff++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void Database::Register(Entry* entry, const char* name, void* data,
+                        uint32_t size, bool dirty) {
+  entry->name = name;
+  entry->data = static_cast<uint8_t*>(data);
+  entry->size = size;
+  entry->hash = dirty ? ~fnv1a(entry->data, size) : fnv1a(entry->data, size);
+  entry->set_count = 0;
+  entry->write_count = 0;
+  entry->dirty = dirty;
+
+  entry->next = list_;
+  list_ = entry;
+
+  if (dirty) {
+    Timer::Start(flush_timer);
+  }
+}
+
+void Database::MarkDirty(Entry* entry) {
+  entry->set_count++;
+  total_set++;
+  if (entry->dirty) {
+    total_coalesce++;
+  } else {
+    entry->dirty = true;
+    Timer::Start(flush_timer);
+  }
+}
+
+void Database::Sync() {
+  for (Entry* entry = list_; entry; entry = entry->next) {
+    if (!entry->dirty) {
+      continue;
+    }
+
+    entry->dirty = false;
+
+    uint32_t hash = fnv1a(entry->data, entry->size);
+    if (hash == entry->hash) {
+      total_skip++;
+      continue;
+    }
+
+    bsp_flash_set_blog(entry->name, entry->data, entry->size);
+    entry->hash = hash;
+    entry->write_count++;
+    total_write++;
+  }
+}
+
+int Database::ShowCMD(void* arg, int argc, char** argv) {
+  XB_UNUSED(arg);
+
+  if (argc == 2 && strcmp(argv[1], "sync") == 0) {
+    Sync();
+    printf("Database synced.\r\n");
+    return 0;
+  }
+
+  if (argc != 1) {
+    printf("[sync] 立即写入flash\r\n");
+    return 0;
+  }
+
+  printf("%-20s %6s %8s %8s %6s\r\n", "key", "size", "set", "write",
+         "dirty");
+
+  for (Entry* entry = list_; entry; entry = entry->next) {
+    printf("%-20s %6u %8u %8u %6s\r\n", entry->name,
+           static_cast<unsigned int>(entry->size),
+           static_cast<unsigned int>(entry->set_count),
+           static_cast<unsigned int>(entry->write_count),
+           entry->dirty ? "yes" : "no");
+  }
+
+  printf("set:%u write:%u skip:%u coalesce:%u\r\n",
+         static_cast<unsigned int>(total_set),
+         static_cast<unsigned int>(total_write),
+         static_cast<unsigned int>(total_skip),
+         static_cast<unsigned int>(total_coalesce));
+
+  return 0;
+}
+
 Database::Database() {
   bsp_flash_init();
 
@@ -60,6 +165,16 @@ Database::Database() {
     return 0;
   };
 
+  auto flush_timer_fn = [](void* arg) {
+    XB_UNUSED(arg);
+    Database::Sync();
+  };
+
+  flush_timer = Timer::CreateMicroseconds(
+      flush_timer_fn, static_cast<void*>(NULL), DATABASE_WRITE_BACK_MS * 1000,
+      Timer::ONE_SHOT, "database");
+  Timer::Stop(flush_timer);
+
   ms_file_init(&sn_tools, "sn_tools", sn_cmd_fn, NULL, 0, false);
   ms_cmd_add(&sn_tools);
 }
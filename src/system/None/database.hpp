@@ -1,13 +1,30 @@
 #pragma once
 
+#include <cstdint>
 #include <cstring>
 
 #include "bsp_flash.h"
 
 namespace System {
+/* Key的数据常驻RAM，Set()只标记为脏，由主循环中的定时器在写回窗口结束后
+ * 统一写入flash，窗口内对同一个Key的多次Set()合并为一次写入。
+ * 底层的EasyFlash/NVS本身以追加日志的方式保存数据，内容未改变时跳过写入。 */
 class Database {
  public:
   Database();
+
+  class Entry {
+   public:
+    const char* name;
+    uint8_t* data;
+    uint32_t size;
+    uint32_t hash;        /* 最近一次写入flash的数据摘要 */
+    uint32_t set_count;   /* Set()调用次数 */
+    uint32_t write_count; /* 实际写入flash次数 */
+    bool dirty;
+    Entry* next;
+  };
+
   template <typename Data>
   class Key {
    public:
@@ -15,10 +32,10 @@ class Database {
       if (bsp_flash_check_blog(name) == sizeof(Data)) {
         bsp_flash_get_blog(name, reinterpret_cast<uint8_t*>(&this->data_),
                            sizeof(Data));
+        Database::Register(&entry_, name, &this->data_, sizeof(Data), false);
       } else {
         memset(&this->data_, 0, sizeof(Data));
-        bsp_flash_set_blog(name, reinterpret_cast<uint8_t*>(&this->data_),
-                           sizeof(Data));
+        Database::Register(&entry_, name, &this->data_, sizeof(Data), true);
       }
     }
 
@@ -26,33 +43,43 @@ class Database {
       if (bsp_flash_check_blog(name) == sizeof(Data)) {
         bsp_flash_get_blog(name, reinterpret_cast<uint8_t*>(&this->data_),
                            sizeof(Data));
+        Database::Register(&entry_, name, &this->data_, sizeof(Data), false);
       } else {
         this->data_ = init_value;
-        bsp_flash_set_blog(name, reinterpret_cast<uint8_t*>(&this->data_),
-                           sizeof(Data));
+        Database::Register(&entry_, name, &this->data_, sizeof(Data), true);
       }
     }
 
-    void Set() {
-      bsp_flash_set_blog(name_, reinterpret_cast<uint8_t*>(&this->data_),
-                         sizeof(Data));
-    }
+    void Set() { Database::MarkDirty(&entry_); }
 
     void Set(const Data& data) {
       this->data_ = data;
-      bsp_flash_set_blog(name_, reinterpret_cast<uint8_t*>(&this->data_),
-                         sizeof(Data));
+      Database::MarkDirty(&entry_);
     }
 
-    void Get() {
-      bsp_flash_get_blog(name_, reinterpret_cast<uint8_t*>(&this->data_),
-                         sizeof(Data));
-    }
+    /* 数据常驻RAM，无需从flash读取 */
+    void Get() {}
 
     operator Data() { return data_; }
 
     Data data_;
     const char* name_;
+
+   private:
+    Entry entry_;
   };
+
+  /* 立即将所有修改写入flash */
+  static void Sync();
+
+  static int ShowCMD(void* arg, int argc, char** argv);
+
+ private:
+  static void Register(Entry* entry, const char* name, void* data,
+                      uint32_t size, bool dirty);
+
+  static void MarkDirty(Entry* entry);
+
+  static Entry* list_;
 };
 }  // namespace System
@@ -6,13 +6,22 @@
 #endif
 
 /* 使用用户自定义的内存分配 */
-#define OM_USE_USER_MALLOC (0)
+#define OM_USE_USER_MALLOC (1)
 
 /* 用户内存分配函数 */
 #if OM_USE_USER_MALLOC
-#include "FreeRTOS.h"
-#define om_malloc pvPortMalloc
-#define om_free vPortFree
+#include <stddef.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* 由System::Memory实现，与C++代码共用内存池 */
+void* system_memory_malloc(size_t size);
+void system_memory_free(void* block);
+#ifdef __cplusplus
+}
+#endif
+#define om_malloc system_memory_malloc
+#define om_free system_memory_free
 #endif
 
 /* 非阻塞延时函数 */
@@ -3,10 +3,11 @@
 #include <mutex.hpp>
 
 #include "bsp_time.h"
+#include "lockfree_queue.hpp"
 #include "om.hpp"
 
 namespace System {
-template <typename Data>
+template <typename Data, QueueMode Mode = QUEUE_LOCKED>
 class Queue {
  public:
   Queue(uint16_t length) {
@@ -51,12 +52,25 @@ class Queue {
 
   uint32_t Size() {
     mutex_.Lock();
-    return om_fifo_readable_item_count(&fifo_);
+    uint32_t ans = om_fifo_readable_item_count(&fifo_);
     mutex_.Unlock();
+    return ans;
   }
 
  private:
   om_fifo_t fifo_;
   System::Mutex mutex_;
 };
+
+template <typename Data>
+class Queue<Data, QUEUE_SPSC> : public SpscQueue<Data> {
+ public:
+  Queue(uint16_t length) : SpscQueue<Data>(length) {}
+};
+
+template <typename Data>
+class Queue<Data, QUEUE_MPSC> : public MpscQueue<Data> {
+ public:
+  Queue(uint16_t length) : MpscQueue<Data>(length) {}
+};
 }  // namespace System
@@ -17,17 +17,21 @@ void Start(RobotParam... param) {
   new Message();
   new Timer();
   new Term();
+  new Term::Command<Timer*>(Timer::self_, Timer::ShowCMD, "timer");
+  new Term::Command<void*>(NULL, Memory::ShowCMD, "memory");
   new Database();
+  new Term::Command<void*>(NULL, Database::ShowCMD, "db");
 
   static auto xrobot_debug_handle = new RobotType(param...);
 
   XB_UNUSED(xrobot_debug_handle);
 
-  uint32_t last_online_time = bsp_time_get_ms();
+#if MEMORY_FREEZE_AFTER_INIT
+  Memory::Freeze();
+#endif
 
   while (1) {
-    Timer::self_->list_.Foreach(Timer::Refresh, NULL);
-    Timer::self_->thread_.SleepUntil(1, last_online_time);
+    Timer::self_->Poll();
   }
 }
 }  // namespace System
@@ -50,6 +50,12 @@ class Thread {
     }
   }
 
+  static void SleepMicroseconds(uint32_t microseconds) {
+    auto last_time = bsp_time_get_us();
+    while ((bsp_time_get_us() - last_time) < microseconds) {
+    }
+  }
+
   void SleepUntil(uint32_t microseconds, uint32_t& last_time) {
     while ((bsp_time_get_ms() - last_time) < microseconds) {
     }
@@ -57,6 +63,32 @@ class Thread {
     last_time += microseconds;
   }
 
+  /* 微秒级周期延时，错过截止时间时跳过已错过的周期并返回false */
+  bool SleepUntilMicroseconds(uint32_t period, uint64_t& last_time) {
+    uint64_t target = last_time + period;
+    uint64_t now = bsp_time_get_us();
+
+    if (target <= now) {
+      last_time = target;
+      if (period != 0 && now - target >= period) {
+        last_time = now - (now - target) % period;
+      }
+      return period == 0;
+    }
+
+    if (target - now > period) {
+      /* 时钟回绕，重新对齐 */
+      target = now + period;
+    }
+
+    while (bsp_time_get_us() < target) {
+    }
+
+    last_time = target;
+
+    return true;
+  }
+
   void Delete() {}
 
   static void Yield() {}
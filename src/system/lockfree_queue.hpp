@@ -0,0 +1,253 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+
+namespace System {
+/* Queue的实现方式，通过模板参数为每个队列单独选择
+ * QUEUE_LOCKED: 加锁的om_fifo，任意线程收发
+ * QUEUE_SPSC: 单生产者单消费者无锁队列，可在中断中使用
+ * QUEUE_MPSC: 多生产者单消费者无锁队列，需要原子读改写 */
+typedef enum { QUEUE_LOCKED, QUEUE_SPSC, QUEUE_MPSC } QueueMode;
+
+/* Cortex-M0/M0+没有LDREX/STREX，原子读改写会变成arm-none-eabi
+ * 不提供的__atomic库函数调用，这类内核上不能使用QUEUE_MPSC */
+#if defined(__ARM_ARCH_6M__)
+#define QUEUE_ATOMIC_RMW 0
+#else
+#define QUEUE_ATOMIC_RMW 1
+#endif
+
+#if defined(__linux__)
+#define QUEUE_CACHE_LINE_SIZE 64
+#else
+#define QUEUE_CACHE_LINE_SIZE 4
+#endif
+
+static inline uint32_t queue_round_up_pow2(uint32_t num) {
+  uint32_t ans = 1;
+  while (ans < num) {
+    ans <<= 1;
+  }
+  return ans;
+}
+
+/* 单生产者单消费者环形队列。head_/tail_为单调递增的计数，分别只由消费者
+ * 和生产者写入，不使用原子读改写，Cortex-M0+上也可以使用。
+ * 存储区比队列长度至少多一个槽，Overwrite时生产者只推进tail_，不等待消费者；
+ * 消费者发现tail_超前超过队列长度时跳过被覆盖的数据，复制期间槽被再次写入时
+ * 重新读取，与Component::Mailbox的序号检查相同。 */
+template <typename Data>
+class SpscQueue {
+ public:
+  static_assert(std::is_trivially_copyable<Data>::value,
+                "Queue data must be trivially copyable");
+
+  SpscQueue(uint16_t length)
+      : length_(length),
+        mask_(queue_round_up_pow2(length + 1) - 1),
+        buff_(static_cast<Data*>(malloc((mask_ + 1) * sizeof(Data)))) {}
+
+  bool Send(const Data& data) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) >= length_) {
+      return false;
+    }
+
+    Write(tail, data);
+    return true;
+  }
+
+  bool Receive(Data& data) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+
+    while (true) {
+      uint32_t tail = tail_.load(std::memory_order_acquire);
+      if (head == tail) {
+        return false;
+      }
+
+      /* 被Overwrite覆盖的数据直接跳过 */
+      if (tail - head > length_) {
+        head = tail - length_;
+      }
+
+      Data tmp = buff_[head & mask_];
+
+      /* 复制期间生产者写到了同一个槽 */
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (tail_.load(std::memory_order_relaxed) - head > mask_) {
+        continue;
+      }
+
+      head_.store(head + 1, std::memory_order_release);
+      data = tmp;
+      return true;
+    }
+  }
+
+  /* 队列满时丢弃最旧的数据，wait-free */
+  bool Overwrite(const Data& data) {
+    Write(tail_.load(std::memory_order_relaxed), data);
+    return true;
+  }
+
+  /* 只能由消费者调用 */
+  bool Reset() {
+    head_.store(tail_.load(std::memory_order_acquire),
+                std::memory_order_release);
+    return true;
+  }
+
+  uint32_t Size() {
+    uint32_t head = head_.load(std::memory_order_acquire);
+    uint32_t size = tail_.load(std::memory_order_acquire) - head;
+    return size > length_ ? length_ : size;
+  }
+
+ private:
+  void Write(uint32_t tail, const Data& data) {
+    /* 消费者读到这次写入的数据时，也能看到之前发布的tail_ */
+    std::atomic_thread_fence(std::memory_order_release);
+
+    buff_[tail & mask_] = data;
+    tail_.store(tail + 1, std::memory_order_release);
+  }
+
+  const uint32_t length_;
+  const uint32_t mask_;
+  Data* buff_;
+  alignas(QUEUE_CACHE_LINE_SIZE) std::atomic<uint32_t> head_{0};
+  alignas(QUEUE_CACHE_LINE_SIZE) std::atomic<uint32_t> tail_{0};
+};
+
+/* 多生产者单消费者环形队列，每个槽带一个序号(Vyukov bounded queue)。
+ * 生产者通过CAS争抢tail_，写完数据后发布序号，消费者只读取已发布的槽。
+ * Overwrite在队列满时以消费者身份丢弃最旧的数据，最旧的槽被抢占的
+ * 生产者或消费者占用时无法腾出位置，重试有限次后丢弃新数据并计数。
+ * 不要在中断中使用，没有原子读改写的内核上不可用。 */
+template <typename Data>
+class MpscQueue {
+ public:
+  static_assert(std::is_trivially_copyable<Data>::value,
+                "Queue data must be trivially copyable");
+  static_assert(QUEUE_ATOMIC_RMW || sizeof(Data) == 0,
+                "QUEUE_MPSC needs atomic read-modify-write");
+
+  MpscQueue(uint16_t length)
+      : length_(length),
+        mask_(queue_round_up_pow2(length) - 1),
+        cell_(static_cast<Cell*>(malloc((mask_ + 1) * sizeof(Cell)))) {
+    for (uint32_t i = 0; i <= mask_; i++) {
+      new (&cell_[i].seq) std::atomic<uint32_t>(i);
+    }
+  }
+
+  bool Send(const Data& data) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    while (true) {
+      uint32_t head = head_.load(std::memory_order_acquire);
+      if (static_cast<int32_t>(tail - head) >= static_cast<int32_t>(length_)) {
+        return false;
+      }
+
+      Cell* cell = &cell_[tail & mask_];
+      int32_t diff = static_cast<int32_t>(
+          cell->seq.load(std::memory_order_acquire) - tail);
+
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(tail, tail + 1,
+                                        std::memory_order_relaxed)) {
+          cell->data = data;
+          cell->seq.store(tail + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        tail = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool Receive(Data& data) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    while (true) {
+      Cell* cell = &cell_[head & mask_];
+      int32_t diff = static_cast<int32_t>(
+          cell->seq.load(std::memory_order_acquire) - (head + 1));
+
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(head, head + 1,
+                                        std::memory_order_acq_rel)) {
+          data = cell->data;
+          cell->seq.store(head + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        head = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /* 队列满时丢弃最旧的数据，无法腾出位置时丢弃data并返回false */
+  bool Overwrite(const Data& data) {
+    Data drop;
+    for (uint32_t i = 0; i <= length_; i++) {
+      if (Send(data)) {
+        return true;
+      }
+      Receive(drop);
+    }
+
+    drop_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  /* 只能由消费者调用 */
+  bool Reset() {
+    Data drop;
+    while (Receive(drop)) {
+    }
+    return true;
+  }
+
+  /* 从队首开始连续已发布、可以被Receive读出的数量，
+   * 已被生产者占用但尚未写完的槽不计入 */
+  uint32_t Size() {
+    uint32_t head = head_.load(std::memory_order_acquire);
+    uint32_t size = 0;
+
+    while (size < length_) {
+      uint32_t pos = head + size;
+      if (cell_[pos & mask_].seq.load(std::memory_order_acquire) != pos + 1) {
+        break;
+      }
+      size++;
+    }
+
+    return size;
+  }
+
+  /* Overwrite无法腾出位置而丢弃的数据数量 */
+  uint32_t Drop() { return drop_.load(std::memory_order_relaxed); }
+
+ private:
+  typedef struct {
+    std::atomic<uint32_t> seq;
+    Data data;
+  } Cell;
+
+  const uint32_t length_;
+  const uint32_t mask_;
+  Cell* cell_;
+  alignas(QUEUE_CACHE_LINE_SIZE) std::atomic<uint32_t> head_{0};
+  alignas(QUEUE_CACHE_LINE_SIZE) std::atomic<uint32_t> tail_{0};
+  std::atomic<uint32_t> drop_{0};
+};
+}  // namespace System
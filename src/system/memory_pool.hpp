@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace System {
+/* 固定大小块内存池。空闲块用块头部保存下一个空闲块的地址，
+ * 从未分配过的块按顺序切出，因此不需要初始化，静态对象在任何构造函数运行前可用。
+ * 内存池本身不加锁，由调用者保证互斥。 */
+class MemoryPool {
+ public:
+  constexpr MemoryPool(uint8_t* buff, uint32_t block_size, uint32_t block_num)
+      : buff_(buff), block_size_(block_size), block_num_(block_num) {}
+
+  void* Alloc() {
+    void* ans = NULL;
+
+    if (free_list_ != NULL) {
+      ans = free_list_;
+      free_list_ = *static_cast<void**>(free_list_);
+    } else if (unused_ < block_num_) {
+      ans = buff_ + unused_ * block_size_;
+      unused_++;
+    } else {
+      if (block_num_ > 0) {
+        failed_++;
+      }
+      return NULL;
+    }
+
+    used_++;
+    if (used_ > max_used_) {
+      max_used_ = used_;
+    }
+
+    return ans;
+  }
+
+  void Free(void* block) {
+    *static_cast<void**>(block) = free_list_;
+    free_list_ = block;
+    used_--;
+  }
+
+  bool Contains(const void* block) const {
+    const uint8_t* addr = static_cast<const uint8_t*>(block);
+    return addr >= buff_ && addr < buff_ + block_size_ * block_num_;
+  }
+
+  uint32_t BlockSize() const { return block_size_; }
+
+  uint32_t BlockNum() const { return block_num_; }
+
+  uint32_t Used() const { return used_; }
+
+  /* 历史最大占用块数 */
+  uint32_t MaxUsed() const { return max_used_; }
+
+  /* 池已满转而使用堆的次数 */
+  uint32_t Failed() const { return failed_; }
+
+ private:
+  uint8_t* buff_;
+  uint32_t block_size_;
+  uint32_t block_num_;
+  uint32_t unused_ = 0;
+  uint32_t used_ = 0;
+  uint32_t max_used_ = 0;
+  uint32_t failed_ = 0;
+  void* free_list_ = NULL;
+};
+}  // namespace System
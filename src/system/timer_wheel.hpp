@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cstdint>
+
+/* Linux下未在Kconfig中配置，使用默认值 */
+#ifndef TIMER_WHEEL_LEVEL_NUM
+#define TIMER_WHEEL_LEVEL_NUM 5
+#endif
+
+#ifndef TIMER_WHEEL_LEVEL_BITS
+#define TIMER_WHEEL_LEVEL_BITS 6
+#endif
+
+namespace System {
+/* 分层时间轮，tick单位为微秒。默认每层64个槽，共5层，覆盖约17.9分钟，
+ * 更远的定时器放在最高层并在级联时重新插入。插入、删除、到期均为O(1)，
+ * 下一次需要处理的时间通过各层占用位图在O(层数)内求出。
+ * 槽只保存一个指向首节点的指针，同一时刻到期的定时器不保证先后顺序。
+ * 时间轮本身不加锁，由调用者保证互斥。 */
+class TimerWheel {
+ public:
+  static const uint32_t LEVEL_BITS = TIMER_WHEEL_LEVEL_BITS;
+  static const uint32_t SLOT_NUM = 1 << LEVEL_BITS;
+  static const uint32_t SLOT_MASK = SLOT_NUM - 1;
+  static const uint32_t LEVEL_NUM = TIMER_WHEEL_LEVEL_NUM;
+  static const uint64_t MAX_DELTA = (1ULL << (LEVEL_BITS * LEVEL_NUM)) - 1;
+
+  static_assert(LEVEL_BITS >= 1 && LEVEL_BITS <= 6,
+                "slot bitmap is 64 bits wide");
+  static_assert(LEVEL_NUM >= 1 && LEVEL_BITS * LEVEL_NUM <= 48,
+                "timer wheel range out of bounds");
+
+  class Node {
+   public:
+    bool Linked() const { return pprev_ != nullptr; }
+
+    uint64_t expires_ = 0;
+
+   private:
+    friend class TimerWheel;
+    Node* next_ = nullptr;
+    Node** pprev_ = nullptr; /* 指向前一个节点的next_或槽 */
+    uint8_t level_ = 0;
+    uint8_t slot_ = 0;
+  };
+
+  explicit TimerWheel(uint64_t now = 0) : base_(now) {}
+
+  uint64_t Now() const { return base_; }
+
+  uint32_t Size() const { return size_; }
+
+  void Add(Node* node) {
+    uint64_t expires = node->expires_;
+    uint64_t delta = expires > base_ ? expires - base_ : 0;
+
+    if (delta > MAX_DELTA) {
+      delta = MAX_DELTA;
+      expires = base_ + MAX_DELTA;
+    } else if (expires < base_) {
+      expires = base_;
+    }
+
+    uint32_t level = 0;
+    while (level < LEVEL_NUM - 1 &&
+           delta >= (1ULL << ((level + 1) * LEVEL_BITS))) {
+      level++;
+    }
+
+    uint32_t index = (expires >> (level * LEVEL_BITS)) & SLOT_MASK;
+
+    node->level_ = static_cast<uint8_t>(level);
+    node->slot_ = static_cast<uint8_t>(index);
+    Link(&slot_[level][index], node);
+
+    bitmap_[level] |= 1ULL << index;
+    size_++;
+  }
+
+  void Remove(Node* node) {
+    if (!node->Linked()) {
+      return;
+    }
+
+    Unlink(node);
+
+    if (slot_[node->level_][node->slot_] == nullptr) {
+      bitmap_[node->level_] &= ~(1ULL << node->slot_);
+    }
+
+    size_--;
+  }
+
+  /* 下一次需要处理的时刻(到期或级联)，时间轮为空时返回UINT64_MAX */
+  uint64_t Next() const {
+    uint64_t next = UINT64_MAX;
+
+    for (uint32_t level = 0; level < LEVEL_NUM; level++) {
+      if (bitmap_[level] == 0) {
+        continue;
+      }
+
+      uint32_t shift = level * LEVEL_BITS;
+      uint64_t start = ((base_ + (1ULL << shift) - 1) >> shift) << shift;
+      uint32_t index = (start >> shift) & SLOT_MASK;
+      uint64_t rotated = (bitmap_[level] >> index) |
+                         (index ? bitmap_[level] << (SLOT_NUM - index) : 0);
+      uint64_t time =
+          start + (static_cast<uint64_t>(__builtin_ctzll(rotated)) << shift);
+
+      if (time < next) {
+        next = time;
+      }
+    }
+
+    return next;
+  }
+
+  /* 处理now及之前到期的定时器，expire回调中可以重新插入或删除节点 */
+  template <typename ExpireFun>
+  void Advance(uint64_t now, ExpireFun expire) {
+    while (size_ > 0) {
+      uint64_t next = Next();
+      if (next > now) {
+        break;
+      }
+
+      base_ = next;
+      Cascade();
+
+      Node* list = nullptr;
+      Take(0, base_ & SLOT_MASK, &list);
+
+      base_++;
+
+      while (list != nullptr) {
+        Node* node = list;
+        Unlink(node);
+        size_--;
+
+        if (node->expires_ >= base_) {
+          Add(node);
+        } else {
+          expire(node);
+        }
+      }
+    }
+
+    if (base_ <= now) {
+      base_ = now + 1;
+    }
+  }
+
+ private:
+  static void Link(Node** head, Node* node) {
+    node->next_ = *head;
+    if (node->next_ != nullptr) {
+      node->next_->pprev_ = &node->next_;
+    }
+    node->pprev_ = head;
+    *head = node;
+  }
+
+  static void Unlink(Node* node) {
+    *node->pprev_ = node->next_;
+    if (node->next_ != nullptr) {
+      node->next_->pprev_ = node->pprev_;
+    }
+    node->pprev_ = nullptr;
+    node->next_ = nullptr;
+  }
+
+  /* 将一个槽中的所有节点移到list，回调中删除其中的节点时仍能正确摘除 */
+  void Take(uint32_t level, uint32_t index, Node** list) {
+    *list = slot_[level][index];
+    if (*list != nullptr) {
+      (*list)->pprev_ = list;
+    }
+
+    slot_[level][index] = nullptr;
+    bitmap_[level] &= ~(1ULL << index);
+  }
+
+  void Cascade() {
+    for (uint32_t level = 1; level < LEVEL_NUM; level++) {
+      uint32_t shift = level * LEVEL_BITS;
+      if ((base_ & ((1ULL << shift) - 1)) != 0) {
+        break;
+      }
+
+      Node* list = nullptr;
+      Take(level, (base_ >> shift) & SLOT_MASK, &list);
+
+      while (list != nullptr) {
+        Node* node = list;
+        Unlink(node);
+        size_--;
+        Add(node);
+      }
+    }
+  }
+
+  uint64_t base_;
+  uint32_t size_ = 0;
+  uint64_t bitmap_[LEVEL_NUM] = {};
+  Node* slot_[LEVEL_NUM][SLOT_NUM] = {};
+};
+}  // namespace System